@@ -0,0 +1,160 @@
+#include "CIPDecoder.h"
+#include "record.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const int maxRun = 32;
+
+
+/* -------------------------------------------------------------------- */
+bool CIPDecoder::operator==(const CIPDecoder & rhs) const
+{
+  return _nResidual == rhs._nResidual && memcmp(_residual, rhs._residual, _nResidual) == 0;
+}
+
+/* -------------------------------------------------------------------- */
+void CIPDecoder::grow(size_t n)
+{
+  size_t old = _stale.size();
+  if (n <= old)
+    return;
+
+  // Never written, so the buffer as it was at Mark().
+  _stale.resize(n, 0);
+  _from.resize(n);
+  for (size_t i = old; i < n; ++i)
+    _from[i] = i;
+}
+
+/* -------------------------------------------------------------------- */
+void CIPDecoder::Mark()
+{
+  for (size_t i = 0; i < _from.size(); ++i)
+    _from[i] = i;
+  _inherited = false;
+}
+
+/* -------------------------------------------------------------------- */
+void CIPDecoder::Rebase(const CIPDecoder & before)
+{
+  grow(before._stale.size());
+  for (size_t i = 0; i < _stale.size(); ++i)
+  {
+    if (_from[i] < 0)
+      continue;
+    size_t from = _from[i];
+    if (from < before._stale.size())
+    {
+      _stale[i] = before._stale[from];
+      _from[i] = before._from[from];
+    }
+    else
+      _stale[i] = 0;
+  }
+  _inherited = before._inherited;
+}
+
+/* -------------------------------------------------------------------- */
+const unsigned char *CIPDecoder::PastEnd(int nSlices)
+{
+  size_t start = nSlices * 8;
+  grow(start + 8);
+  for (size_t i = start; i < start + 8; ++i)
+    if (_from[i] >= 0)
+      _inherited = true;
+  return &_stale[start];
+}
+
+/* -------------------------------------------------------------------- */
+int CIPDecoder::Decode(const unsigned char src[], int nbytes, unsigned char *buffer,
+		const unsigned char * & slices)
+{
+  static const unsigned char zeros[maxRun] = { 0 };
+  static const unsigned char ones[maxRun] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+  memcpy(buffer, _residual, _nResidual);
+  unsigned char *out = buffer + _nResidual;
+  _nResidual = 0;
+
+  /* Runs are 1 to 32 bytes.  Write a whole 32 every time, a fixed size
+   * copy is a couple of vector stores where a variable one is a call, and
+   * bufferSize leaves room past the end for it.  The next run overwrites
+   * what is past this one.
+   */
+  for (int i = 0; i < nbytes; ++i)
+  {
+    unsigned char b = src[i];
+    int n = (b & 0x1F) + 1;
+
+    if ((b & 0x20))	// This is a dummy byte; for alignment purposes.
+      continue;
+
+    if ((b & 0xE0) == 0)	// n bytes of image data follow.
+    {
+      if (i + 1 + maxRun <= nbytes)
+        memcpy(out, &src[i+1], maxRun);
+      else			// Don't read past the record.
+        memcpy(out, &src[i+1], n = std::min(n, nbytes - i - 1));
+      out += n;
+      i += n;
+    }
+    else
+    {
+      memcpy(out, (b & 0x80) ? zeros : ones, maxRun);
+      out += n;
+    }
+  }
+
+  int nOut = out - buffer;
+  grow(nOut + 8);
+
+  // Align data, slices start on mod 8 from the first whole sync word.
+  int offset = -1;
+  for (const unsigned char *p = buffer; p + 8 <= out; ++p)
+  {
+    if ((p = (const unsigned char *)memchr(p, syncString[0], out - p)) == 0 || p + 8 > out)
+      break;
+    if (memcmp(p, syncString, 8) == 0)
+    {
+      offset = (p - buffer) % 8;
+      break;
+    }
+  }
+
+  // Else one that runs on into the stale bytes.
+  for (int i = std::max(0, nOut - 7); offset < 0 && i < nOut; ++i)
+  {
+    if (memcmp(&buffer[i], syncString, nOut - i))
+      continue;
+    for (int j = nOut; j < i + 8; ++j)
+      if (_from[j] >= 0)
+        _inherited = true;
+    if (memcmp(&_stale[nOut], &syncString[nOut - i], i + 8 - nOut) == 0)
+      offset = i % 8;
+  }
+  offset = std::max(offset, 0);
+
+  slices = buffer + offset;
+  nOut -= offset;
+
+  /* The old buffer was realigned by moving all of it down by offset, so
+   * the stale bytes just past the data came down with it.
+   */
+  unsigned char tail[8];
+  int32_t tailFrom[8];
+  memcpy(tail, &_stale[nOut + offset], offset);
+  memcpy(tailFrom, &_from[nOut + offset], offset * sizeof(int32_t));
+  memcpy(&_stale[0], slices, nOut);
+  std::fill(_from.begin(), _from.begin() + nOut, -1);
+  memcpy(&_stale[nOut], tail, offset);
+  memcpy(&_from[nOut], tailFrom, offset * sizeof(int32_t));
+
+  // Carry the partial slice at the end over to the next record.
+  _nResidual = nOut % 8;
+  memcpy(_residual, &slices[nOut - _nResidual], _nResidual);
+
+  return nOut / 8;
+}
@@ -0,0 +1,79 @@
+#ifndef _cipdecoder_h_
+#define _cipdecoder_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * DMT CIP/PIP run length decoder for one probe.  The image data is one run
+ * length encoded stream, and slices and sync words straddle records, so
+ * the bytes past the last full slice of a record are carried over to the
+ * next.  That carry over is all the state there is and it lives here, so
+ * probes (and parallel decode chunks) each with their own decoder can run
+ * at the same time.
+ *
+ * A sync word in the last slice of a record has always taken its time word
+ * from whatever the decode buffer held past the end, left there by earlier
+ * records.  To give the same results, a copy of that buffer is kept as it
+ * would be, along with where each byte of it came from, so a decoder warmed
+ * up part way through can tell whether it read anything from before then,
+ * and if not, be rebased onto the exact state.
+ */
+class CIPDecoder
+{
+public:
+  /// Output buffer Decode() needs; worst case every byte of a record is a 32 byte run.
+  static const size_t bufferSize = 16 + 4096 * 32 + 32;
+
+  CIPDecoder() : _nResidual(0), _inherited(false) { }
+
+  /// Compares the carry over only, see Inherited() for the stale bytes.
+  bool operator==(const CIPDecoder & rhs) const;
+
+  /**
+   * Decode one record's image data into buffer, after the bytes carried
+   * over from the last record.  Slices are aligned on the first sync word
+   * by starting them part way into buffer, rather than moving the data.
+   * @param buffer at least bufferSize bytes.
+   * @param slices set to the first slice, in buffer.
+   * @returns number of 8 byte slices.
+   */
+  int Decode(const unsigned char src[], int nbytes, unsigned char *buffer,
+		const unsigned char * & slices);
+
+  /**
+   * The slice after the last one the last Decode() returned, as the old
+   * decode buffer had it: the carried over bytes, then stale data.
+   */
+  const unsigned char *PastEnd(int nSlices);
+
+  /**
+   * Start over on where the stale bytes came from; anything read from
+   * before here sets Inherited().
+   */
+  void Mark();
+
+  bool Inherited() const { return _inherited; }
+
+  /**
+   * Replace the stale bytes that came from before Mark() with the ones
+   * from before, the exact state at that point.
+   */
+  void Rebase(const CIPDecoder & before);
+
+private:
+  void grow(size_t n);
+
+  unsigned char _residual[16];
+  size_t _nResidual;
+
+  // The old decode buffer, aligned, and for each byte -1 if decoded since
+  // Mark(), or where in the buffer it was at Mark().
+  std::vector<unsigned char> _stale;
+  std::vector<int32_t> _from;
+  bool _inherited;
+};
+
+#endif
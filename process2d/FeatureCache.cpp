@@ -0,0 +1,156 @@
+#include "FeatureCache.h"
+
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+const char FeatureCache::magic[8] = { 'P', '2', 'D', 'F', 'E', 'A', 'T', 0 };
+
+static const size_t bufferSize = 1 << 20;
+
+
+/* -------------------------------------------------------------------- */
+FeatureCache::FeatureCache(const string & dataFile, const string & probeId)
+  : _fp(0), _buffer(0), _writing(false)
+{
+  size_t pos = dataFile.rfind(".2d");
+  string base = (pos == string::npos) ? dataFile : dataFile.substr(0, pos);
+
+  _cacheFile = base + "_" + probeId + ".2Dfeat";
+  _tmpFile = _cacheFile + ".tmp";
+  memset(&_header, 0, sizeof(_header));
+}
+
+/* -------------------------------------------------------------------- */
+FeatureCache::~FeatureCache()
+{
+  // A cache that was never committed is incomplete, don't leave it around.
+  bool uncommitted = _fp && _writing;
+  close();
+  if (uncommitted)
+    unlink(_tmpFile.c_str());
+}
+
+/* -------------------------------------------------------------------- */
+void FeatureCache::close()
+{
+  if (_fp)
+    fclose(_fp);
+  _fp = 0;
+  _writing = false;
+  delete [] _buffer;
+  _buffer = 0;
+}
+
+/* -------------------------------------------------------------------- */
+bool FeatureCache::OpenRead(Key & key, const std::function<uint64_t()> & fileHash)
+{
+  close();
+
+  if ((_fp = fopen(_cacheFile.c_str(), "rb")) == 0)
+    return false;
+
+  Header header;
+  if (fread(&header, sizeof(header), 1, _fp) != 1 ||
+      memcmp(header.magic, magic, sizeof(magic)) || header.version != version)
+  {
+    close();
+    return false;
+  }
+
+  // Everything but the file contents first; hashing is the expensive part.
+  Key match = key;
+  match.fileHash = header.key.fileHash;
+  match.fileMtime = header.key.fileMtime;
+  if (!(header.key == match))
+  {
+    close();
+    return false;
+  }
+
+  // Same size and time, take it as the same file; otherwise by content.
+  bool touched = header.key.fileMtime != key.fileMtime;
+  key.fileHash = touched ? fileHash() : header.key.fileHash;
+  if (key.fileHash != header.key.fileHash)
+  {
+    close();
+    return false;
+  }
+
+  // Truncated, e.g. disk filled up.
+  long body = (long)header.nParticles * header.key.recordSize;
+  if (fseek(_fp, 0, SEEK_END) != 0 || ftell(_fp) != (long)sizeof(header) + body)
+  {
+    close();
+    return false;
+  }
+  fseek(_fp, sizeof(header), SEEK_SET);
+
+  if (touched)
+  {
+    header.key.fileMtime = key.fileMtime;
+    FILE *fp = fopen(_cacheFile.c_str(), "r+b");
+    if (fp)
+    {
+      fwrite(&header, sizeof(header), 1, fp);
+      fclose(fp);
+    }
+  }
+
+  _header = header;
+  _buffer = new char[bufferSize];
+  setvbuf(_fp, _buffer, _IOFBF, bufferSize);
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+size_t FeatureCache::Read(void *buf, size_t n)
+{
+  if (_fp == 0)
+    return 0;
+
+  return fread(buf, _header.key.recordSize, n, _fp);
+}
+
+/* -------------------------------------------------------------------- */
+bool FeatureCache::Create(const Key & key)
+{
+  close();
+
+  if ((_fp = fopen(_tmpFile.c_str(), "w+b")) == 0)
+    return false;
+
+  memset(&_header, 0, sizeof(_header));
+  memcpy(_header.magic, magic, sizeof(magic));
+  _header.version = version;
+  _header.key = key;
+
+  _buffer = new char[bufferSize];
+  setvbuf(_fp, _buffer, _IOFBF, bufferSize);
+
+  // Placeholder, the counts are filled in by Commit().
+  fwrite(&_header, sizeof(_header), 1, _fp);
+  _writing = true;
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+int FeatureCache::Commit(int64_t nRecords)
+{
+  if (_fp == 0 || !_writing)
+    return 1;
+
+  _header.nRecords = nRecords;
+  rewind(_fp);
+  bool ok = fwrite(&_header, sizeof(_header), 1, _fp) == 1;
+  ok = (fflush(_fp) == 0) && ok;
+  close();
+
+  if (!ok || rename(_tmpFile.c_str(), _cacheFile.c_str()) != 0)
+  {
+    unlink(_tmpFile.c_str());
+    return 1;
+  }
+  return 0;
+}
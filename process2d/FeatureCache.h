@@ -0,0 +1,112 @@
+#ifndef _featurecache_h_
+#define _featurecache_h_
+
+#include <string>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+
+
+/**
+ * Decoded particles for one probe, persisted next to the 2D file so later
+ * runs that only change rejection, binning or derived parameters can skip
+ * decoding and sizing, and go straight to the per second accumulation.
+ *
+ * The cache is only used if its Key matches this run: same 2D file (by
+ * size and modification time, or failing that content hash), probe, time
+ * range, and particle record layout.  Sizing
+ * method is not part of it, particles are re-sized as they are read back.  It is
+ * written to a temporary file and renamed into place once complete, so an
+ * interrupted run never leaves a partial cache behind.
+ */
+class FeatureCache
+{
+public:
+  /**
+   * Everything the cached particles depend on.
+   */
+  struct Key
+  {
+    uint64_t fileHash;		// RecordFile::Hash() of the 2D file.
+    uint64_t fileSize;
+    int64_t fileMtime;		// ns since the epoch.
+    char probeId[2];
+    int32_t nDiodes;
+    float resolution;
+    int32_t hasTASX;		// Decode uses record tas without it.
+    int64_t starttime, stoptime;
+    uint32_t recordSize;	// sizeof the cached record, catches layout changes.
+
+    bool operator==(const Key &) const = default;
+  };
+
+  FeatureCache(const std::string & dataFile, const std::string & probeId);
+  ~FeatureCache();
+
+  const std::string & fileName() const { return _cacheFile; }
+
+  /**
+   * Open an existing cache for reading.  Hashing a multi-GB 2D file reads
+   * all of it, so key.fileHash is left to fileHash(), only called when the
+   * file size matches but the modification time does not (a copied or
+   * touched file); key.fileHash is set if it is.  A cache found current
+   * that way gets the new modification time, so the next run needn't hash.
+   * @returns true if there is one and it matches key.
+   */
+  bool OpenRead(Key & key, const std::function<uint64_t()> & fileHash);
+
+  /**
+   * Read the next n records at most into buf.
+   * @returns number of records read, 0 at the end.
+   */
+  size_t Read(void *buf, size_t n);
+
+  /**
+   * Number of 2D records that were decoded to build the cache.
+   */
+  int64_t nRecords() const { return _header.nRecords; }
+
+  /**
+   * Number of particles in the cache.
+   */
+  int64_t size() const { return _header.nParticles; }
+
+  /**
+   * Start a new cache, in a temporary file.
+   * @returns true on success.
+   */
+  bool Create(const Key & key);
+
+  void Append(const void *rec)
+  { fwrite(rec, _header.key.recordSize, 1, _fp); ++_header.nParticles; }
+
+  /**
+   * Finish the new cache and move it into place.
+   * @returns 0 on success.
+   */
+  int Commit(int64_t nRecords);
+
+private:
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    Key key;
+    int64_t nParticles;
+    int64_t nRecords;
+  };
+
+  static const char magic[8];
+  static const uint32_t version = 3;
+
+  void close();
+
+  std::string _cacheFile;
+  std::string _tmpFile;
+  FILE *_fp;
+  char *_buffer;
+  bool _writing;
+  Header _header;
+};
+
+#endif
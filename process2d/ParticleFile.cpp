@@ -0,0 +1,147 @@
+#include "ParticleFile.h"
+#include "config.h"
+#include "netcdf.h"
+#include "probe.h"
+#include "particle.h"
+
+#include <iostream>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+void ParticleFile::Columns::Add(const ParticleBatch & batch, int t)
+{
+  time.insert(time.end(), batch.size(), t);
+  inttime.insert(inttime.end(), batch.inttime.begin(), batch.inttime.end());
+  size_.insert(size_.end(), batch.size_.begin(), batch.size_.end());
+  csize.insert(csize.end(), batch.csize.begin(), batch.csize.end());
+  xsize.insert(xsize.end(), batch.xsize.begin(), batch.xsize.end());
+  ysize.insert(ysize.end(), batch.ysize.begin(), batch.ysize.end());
+  eadsize.insert(eadsize.end(), batch.eadsize.begin(), batch.eadsize.end());
+  area.insert(area.end(), batch.area.begin(), batch.area.end());
+  holearea.insert(holearea.end(), batch.holearea.begin(), batch.holearea.end());
+  circlearea.insert(circlearea.end(), batch.circlearea.begin(), batch.circlearea.end());
+  xcenter.insert(xcenter.end(), batch.xcenter.begin(), batch.xcenter.end());
+  ycenter.insert(ycenter.end(), batch.ycenter.begin(), batch.ycenter.end());
+  flags.insert(flags.end(), batch.flags.begin(), batch.flags.end());
+}
+
+/* -------------------------------------------------------------------- */
+void ParticleFile::Columns::clear()
+{
+  time.clear(); inttime.clear();
+  size_.clear(); csize.clear(); xsize.clear(); ysize.clear(); eadsize.clear();
+  area.clear(); holearea.clear(); circlearea.clear(); xcenter.clear(); ycenter.clear();
+  flags.clear();
+}
+
+
+/* -------------------------------------------------------------------- */
+ParticleFile::ParticleFile(const string & fileName, const Config & cfg)
+  : _fileName(fileName), _timeUnits(NetCDF::timeUnits(cfg)), _file(0)
+{
+  _file = new NcFile(_fileName, NcFile::replace);
+
+  if (_file->isNull())
+  {
+    cerr << "process2d: Failed to create particle file " << _fileName << endl;
+    delete _file;
+    _file = 0;
+    return;
+  }
+
+  _file->putAtt("institution", "NCAR Research Aviation Facility");
+  _file->putAtt("Source", "NCAR/RAF Fast-2D Processing Software, particle level output");
+  _file->putAtt("ProjectName", cfg.project);
+  _file->putAtt("FlightNumber", cfg.flightNumber);
+  _file->putAtt("FlightDate", cfg.flightDate);
+  _file->putAtt("Raw_2D_Data_File", cfg.inputFile);
+}
+
+/* -------------------------------------------------------------------- */
+ParticleFile::~ParticleFile()
+{
+  if (_file)
+    _file->close();
+  delete _file;
+}
+
+/* -------------------------------------------------------------------- */
+void ParticleFile::AddProbe(const ProbeInfo & probe)
+{
+  if (!_file)
+    return;
+
+  NcDim dim = _file->addDim("particle" + probe.suffix);	// unlimited
+
+  auto add = [&](const char *name, const NcType & type, const char *units, const char *long_name)
+  {
+    NcVar var = _file->addVar(name + probe.suffix, type, dim);
+    if (var.isNull())
+    {
+      cerr << "ParticleFile: Failed to create variable " << name + probe.suffix << endl;
+      return var;
+    }
+    var.putAtt("units", units);
+    var.putAtt("long_name", long_name);
+    var.putAtt("SerialNumber", probe.serialNumber);
+    return var;
+  };
+
+  add("particle_time", ncInt, _timeUnits.c_str(), "Second the particle was recorded in");
+  add("particle_inttime", ncDouble, "seconds", "Interarrival time");
+  add("particle_size", ncFloat, "um", "Diameter used for binning, per sizing method");
+  add("particle_csize", ncFloat, "um", "Enclosing circle diameter");
+  add("particle_xsize", ncFloat, "um", "Size across the array");
+  add("particle_ysize", ncFloat, "um", "Size along the airflow");
+  add("particle_eadsize", ncFloat, "um", "Equivalent area diameter");
+  add("particle_area", ncFloat, "pixels", "Shadowed area");
+  add("particle_holearea", ncFloat, "pixels", "Enclosed hole area");
+  add("particle_circlearea", ncFloat, "pixels", "Enclosing circle area within the array");
+  add("particle_xcenter", ncFloat, "pixels", "Enclosing circle center, diode");
+  add("particle_ycenter", ncFloat, "pixels", "Enclosing circle center, slice");
+
+  NcVar var = add("particle_flags", ncUbyte, "1", "Particle flags");
+  if (!var.isNull())
+  {
+    const unsigned char masks[] = { ParticleBatch::ALLIN, ParticleBatch::CENTERIN,
+	ParticleBatch::WREJECT, ParticleBatch::IREJECT, ParticleBatch::DOFREJECT };
+    var.putAtt("flag_masks", ncUbyte, 5, masks);
+    var.putAtt("flag_meanings", "allin centerin water_reject ice_reject dof_reject");
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void ParticleFile::Write(const ProbeInfo & probe, const Columns & cols)
+{
+  if (!_file || cols.size() == 0)
+    return;
+
+  NcDim dim = _file->getDim("particle" + probe.suffix);
+  if (dim.isNull())
+    return;
+
+  vector<size_t> start(1, dim.getSize()), count(1, cols.size());
+
+  auto put = [&](const char *name, const auto & column)
+  {
+    NcVar var = _file->getVar(name + probe.suffix);
+    if (!var.isNull())
+      var.putVar(start, count, column.data());
+  };
+
+  put("particle_time", cols.time);
+  put("particle_inttime", cols.inttime);
+  put("particle_size", cols.size_);
+  put("particle_csize", cols.csize);
+  put("particle_xsize", cols.xsize);
+  put("particle_ysize", cols.ysize);
+  put("particle_eadsize", cols.eadsize);
+  put("particle_area", cols.area);
+  put("particle_holearea", cols.holearea);
+  put("particle_circlearea", cols.circlearea);
+  put("particle_xcenter", cols.xcenter);
+  put("particle_ycenter", cols.ycenter);
+  put("particle_flags", cols.flags);
+}
@@ -0,0 +1,71 @@
+#ifndef _particlefile_h_
+#define _particlefile_h_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class Config;
+class ProbeInfo;
+class ParticleBatch;
+
+namespace netCDF { class NcFile; }
+
+
+/**
+ * Particle level output, for statistics that would otherwise need process2d
+ * to be re-run.  A separate netCDF file with one unlimited "particle"
+ * dimension per probe and a column per Particle field.
+ *
+ * Each ProbeProcessor collects its particles in a ParticleColumns buffer
+ * and posts it to the netCDF writer thread (NetCDF::Post()) once it fills
+ * up, so the file is written in large chunks, along with the main output.
+ * Caller holds NetCDF::lock() around any call here, the netCDF library is
+ * shared with the main output.
+ */
+class ParticleFile
+{
+public:
+  /**
+   * Column buffer for one probe's particles.
+   */
+  struct Columns
+  {
+    void Add(const ParticleBatch & batch, int time);
+    size_t size() const { return time.size(); }
+    void clear();
+
+    std::vector<int> time;		// Seconds since start time.
+    std::vector<double> inttime;
+    std::vector<float> size_, csize, xsize, ysize, eadsize;
+    std::vector<float> area, holearea, circlearea, xcenter, ycenter;
+    std::vector<uint8_t> flags;		// ParticleBatch flag bits.
+  };
+
+  /// Particles to buffer per probe before writing.
+  static const size_t chunkParticles = 65536;
+
+  ParticleFile(const std::string & fileName, const Config & cfg);
+  ~ParticleFile();
+
+  bool isOpen() const { return _file != 0; }
+
+  const std::string & fileName() const { return _fileName; }
+
+  /**
+   * Define the dimension and variables for a probe.
+   */
+  void AddProbe(const ProbeInfo & probe);
+
+  /**
+   * Append a probe's buffered particles.
+   */
+  void Write(const ProbeInfo & probe, const Columns & cols);
+
+private:
+  std::string _fileName;
+  std::string _timeUnits;
+  netCDF::NcFile *_file;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "ProbeData.h"
 
 #include <cmath>
+#include <algorithm>
 
 ProbeData::ProbeData(size_t size) : _size(size)
 {
@@ -35,9 +36,41 @@ ProbeData::ProbeData(size_t size) : _size(size)
 }
 
 
-void ProbeData::ReplaceNANwithMissingData()
+ProbeData::ProbeData(const ProbeData & from, size_t n) : _size(n)
 {
-  for (size_t i = 0; i < all.total_conc.size(); i++)
+  auto copy = [n](std::vector<float> & to, const std::vector<float> & v)
+  {
+    to.assign(v.begin(), v.begin() + n);
+  };
+
+  copy(tas, from.tas);
+  copy(cpoisson1, from.cpoisson1);
+  copy(cpoisson2, from.cpoisson2);
+  copy(cpoisson3, from.cpoisson3);
+  copy(pcutoff, from.pcutoff);
+  copy(corrfac, from.corrfac);
+
+  for (int k = 0; k < 2; ++k)
+  {
+    derived & d = k ? round : all;
+    const derived & f = k ? from.round : from.all;
+    copy(d.accepted, f.accepted);
+    copy(d.rejected, f.rejected);
+    copy(d.total_conc, f.total_conc);
+    copy(d.total_conc100, f.total_conc100);
+    copy(d.total_conc150, f.total_conc150);
+    copy(d.dbz, f.dbz);
+    copy(d.dbar, f.dbar);
+    copy(d.disp, f.disp);
+    copy(d.lwc, f.lwc);
+    copy(d.eff_rad, f.eff_rad);
+  }
+}
+
+
+void ProbeData::ReplaceNANwithMissingData(size_t first, size_t n)
+{
+  for (size_t i = first; i < first+n; i++)
   {
     if (std::isnan(all.total_conc[i]))
       all.total_conc[i] = all.dbz[i] = all.dbar[i] = all.disp[i] =
@@ -49,3 +82,34 @@ void ProbeData::ReplaceNANwithMissingData()
 		round.rejected[i] = round.total_conc100[i] = round.total_conc150[i] = -32767.0;
   }
 }
+
+
+void ProbeData::Shift(size_t n)
+{
+  auto shift = [n](std::vector<float> & v, float init)
+  {
+    std::move(v.begin() + n, v.end(), v.begin());
+    std::fill(v.end() - n, v.end(), init);
+  };
+
+  shift(tas, 0.0);
+  shift(cpoisson1, 0.0);
+  shift(cpoisson2, 0.0);
+  shift(cpoisson3, 0.0);
+  shift(pcutoff, 0.0);
+  shift(corrfac, 0.0);
+
+  for (derived *d : { &all, &round })
+  {
+    shift(d->accepted, 0.0);
+    shift(d->rejected, 0.0);
+    shift(d->total_conc, 0.0);
+    shift(d->total_conc100, 0.0);
+    shift(d->total_conc150, 0.0);
+    shift(d->dbz, -100.0);
+    shift(d->dbar, 0.0);
+    shift(d->disp, 0.0);
+    shift(d->lwc, 0.0);
+    shift(d->eff_rad, 0.0);
+  }
+}
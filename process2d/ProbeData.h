@@ -17,7 +17,21 @@ public:
 
   ProbeData(size_t size);
 
-  void ReplaceNANwithMissingData();
+  /**
+   * Copy of the first n seconds of from.
+   */
+  ProbeData(const ProbeData & from, size_t n);
+
+  /**
+   * Replace NAN with missing value for seconds first..first+n-1.
+   */
+  void ReplaceNANwithMissingData(size_t first, size_t n);
+
+  /**
+   * Move seconds n..size()-1 down to the front and reset the rest to their
+   * initial values.  For writing out the output in blocks.
+   */
+  void Shift(size_t n);
 
   int size() const { return _size; }
 
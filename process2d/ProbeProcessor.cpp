@@ -0,0 +1,1397 @@
+#include "ProbeProcessor.h"
+#include "ThreadPool.h"
+#include "netcdf.h"
+#include "SyncScan.h"
+#include "SliceUnpack.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+ProbeProcessor::DecodeState::DecodeState(int nRows, int nDiodes)
+  : roi(nRows, nDiodes), slice_count(0), features(nDiodes),
+    firsttimeline(0), lasttimeline(0), lastbuffertime(0), buffertime(0),
+    firsttimeflag(true), tas(0.1), last_time1hz(0), firstRecord(true), done(false)
+{
+}
+
+/* -------------------------------------------------------------------- */
+bool ProbeProcessor::DecodeState::operator==(const DecodeState & rhs) const
+{
+  // Only the roi slices of the particle in progress matter.
+  return slice_count == rhs.slice_count &&
+	memcmp(roi.row(0), rhs.roi.row(0), sizeof(uint64_t) * slice_count * roi.nWords()) == 0 &&
+	cip == rhs.cip &&
+	firsttimeline == rhs.firsttimeline && lasttimeline == rhs.lasttimeline &&
+	lastbuffertime == rhs.lastbuffertime && buffertime == rhs.buffertime &&
+	firsttimeflag == rhs.firsttimeflag && tas == rhs.tas &&
+	last_time1hz == rhs.last_time1hz && particle == rhs.particle &&
+	firstRecord == rhs.firstRecord && done == rhs.done;
+}
+
+
+/* -------------------------------------------------------------------- */
+ProbeProcessor::SizingSet::SizingSet(const ProbeInfo & p, Config::SizeMethod sm,
+	Config::Method em, const std::string & sfx, int rows)
+  : probe(p), smethod(sm), eawmethod(em), data(rows)
+{
+  if (sfx.length())
+    probe.suffix = sfx;
+  probe.ComputeSamplearea(eawmethod);
+
+  count_all.resize(rows);
+  count_round.resize(rows);
+  conc_all.resize(rows);
+  conc_round.resize(rows);
+
+  // Allocate contiguous data block.
+  size_t N = rows * (probe.numBins+binoffset);
+  count_all[0] = new float[N];
+  count_round[0] = new float[N];
+  conc_all[0] = new float[N];
+  conc_round[0] = new float[N];
+
+  //Initialize all these to zero
+  memset((void *)count_all[0], 0, sizeof(float) * N);
+  memset((void *)count_round[0], 0, sizeof(float) * N);
+  memset((void *)conc_all[0], 0, sizeof(float) * N);
+  memset((void *)conc_round[0], 0, sizeof(float) * N);
+
+  // Set up pointers into contiguous data block.
+  for (int i = 1; i < rows; i++) {
+    int offset = i * (probe.numBins+binoffset);
+
+    count_all[i] = count_all[0] + offset;
+    count_round[i] = count_round[0] + offset;
+    conc_all[i] = conc_all[0] + offset;
+    conc_round[i] = conc_round[0] + offset;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+ProbeProcessor::SizingSet::~SizingSet()
+{
+  delete [] count_all[0];
+  delete [] count_round[0];
+  delete [] conc_all[0];
+  delete [] conc_round[0];
+}
+
+/* -------------------------------------------------------------------- */
+ProbeProcessor::ProbeProcessor(Config & cfg, NetCDF & ncfile, ProbeInfo & probe, ThreadPool *pool,
+	ParticleFile *particleFile)
+  : _cfg(cfg), _ncfile(ncfile), _probe(probe), _pool(pool), _particleFile(particleFile),
+    _probetype(probe.id[0]),
+    _probenumber(probe.id[1]), _hasTASX(ncfile.hasTASX()),
+    _bytesPerSlice(probe.nDiodes / 8), _slicesPerRecord(4096 / _bytesPerSlice),
+    _decode(selectDecoder(probe)),
+    _numtimes(cfg.stoptime - cfg.starttime + 1), _buffcount(0), _done(false),
+    _base(0), _window(cfg.streamSeconds > 0 ? std::min(2*cfg.streamSeconds, _numtimes) : _numtimes),
+    _lateSeconds(0), _defined(false),
+    _state(_slicesPerRecord*3, probe.nDiodes), _endOfData(false), _finished(false),
+    _iitq(0)
+{
+  _image_buff = new unsigned char[CIPDecoder::bufferSize];
+  _probe.ComputeSamplearea(_cfg.eawmethod);
+
+  if (_cfg.profile)
+    _profile.reset(new Profile);
+
+  assert(_numtimes >= 0);
+
+  // Histogram sets, the command line sizing and acceptance methods first.
+  _sets.emplace_back(new SizingSet(_probe, _cfg.smethod, _cfg.eawmethod, "", _window));
+  for (const auto & m : _cfg.extraMethods)
+    if (m.first != _cfg.smethod || m.second != _cfg.eawmethod)
+      _sets.emplace_back(new SizingSet(_probe, m.first, m.second,
+		_probe.suffix + "_" + Config::methodTag(m.first, m.second), _window));
+
+  // Shattering correction and interarrival setup
+  memset(_bestfit, 0, sizeof(_bestfit));
+  memset(_itq, 0, sizeof(_itq));
+  _itq[0] = 1;
+
+  _count_it.resize(_window);
+  _count_it[0] = new int [_window*(_cfg.nInterarrivalBins+binoffset)];
+  memset((void *)_count_it[0], 0, sizeof(int)*_window*(_cfg.nInterarrivalBins+binoffset));
+  for (int i = 1; i < _window; i++)
+  {
+    _count_it[i] = _count_it[0] + (i * (_cfg.nInterarrivalBins+binoffset));
+  }
+
+  for (int i = 0; i <= _cfg.nInterarrivalBins; i++)
+    _it_endpoints.push_back(pow(10, ((float)i-35)/5.0));
+  for (int i = 0; i < _cfg.nInterarrivalBins; i++)
+    _it_midpoints.push_back(pow(10, ((float)i-34.5)/5.0));
+  _itBins = BinLookup(_it_endpoints);
+
+  // Histogram of what is in the queue, kept up to date as it turns over.
+  _itHist.assign(_cfg.nInterarrivalBins, 0);
+  for (int i = 0; i < nitq; i++)
+    addInterarrival(_itq[i], 1);
+
+  // All of it now, so streaming doesn't go back to the file for each block.
+  if (_hasTASX)
+  {
+    _tasx.resize(_numtimes);
+    _ncfile.readTrueAirspeed(&_tasx[0], 0, _numtimes);
+    for (auto & set : _sets)
+      std::copy(_tasx.begin(), _tasx.begin() + _window, set->data.tas.begin());
+  }
+
+  if (_particleFile)
+  {
+    std::lock_guard<std::mutex> lock(_ncfile.lock());
+    _particleFile->AddProbe(_probe);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+ProbeProcessor::~ProbeProcessor()
+{
+  delete [] _image_buff;
+
+  delete [] _count_it[0];
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::Start()
+{
+  _worker = std::thread(&ProbeProcessor::run, this);
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::Push(const P2d_rec *buffer)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _queueNotFull.wait(lock, [this]{ return _queue.size() < maxQueue || _done; });
+
+  if (_done)	// Past end time, nothing more is wanted.
+    return;
+
+  _queue.push_back(buffer);
+  _queueNotEmpty.notify_one();
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::EndOfData()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _endOfData = true;
+  _queueNotEmpty.notify_one();
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::Join()
+{
+  if (_worker.joinable())
+    _worker.join();
+}
+
+/* -------------------------------------------------------------------- */
+static bool sameSecond(const P2d_rec *a, const P2d_rec *b)
+{
+  return a->second == b->second && a->minute == b->minute && a->hour == b->hour;
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::run()
+{
+  std::vector<const P2d_rec *> records;
+  const P2d_rec *buffer;
+
+  while (true)
+  {
+    {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _queueNotEmpty.wait(lock, [this]{ return !_queue.empty() || _endOfData; });
+
+    if (_queue.empty())
+      break;
+
+    buffer = _queue.front();
+    _queue.pop_front();
+    _queueNotFull.notify_one();
+    }
+
+    if (_pool == 0)
+      ProcessRecord(*buffer);
+    else
+    {
+      // Cut chunks where the record time moves on to a new second.
+      if (records.size() >= chunkRecords && !sameSecond(records.back(), buffer))
+      {
+        dispatchChunk(records);
+        while (_pending.size() > 2 * _pool->size())
+          collectChunk();
+      }
+      records.push_back(buffer);
+    }
+
+    if (_done)
+    {
+      // Release a reader that may be blocked on a full queue.
+      std::lock_guard<std::mutex> lock(_mutex);
+      _queue.clear();
+      _queueNotFull.notify_all();
+      break;
+    }
+  }
+
+  if (!records.empty() && !_done)
+    dispatchChunk(records);
+  while (!_chunks.empty())
+    collectChunk();
+
+  ComputeDerived();
+
+  // Behind any blocks streamed out, so they are written first.
+  _ncfile.Post([this]() { _finished = true; });
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::dispatchChunk(std::vector<const P2d_rec *> & records)
+{
+  auto chunk = std::make_shared<Chunk>(_slicesPerRecord*3, _probe.nDiodes);
+  chunk->records.swap(records);
+  records.clear();
+
+  // Nothing outstanding means _state is exactly where this chunk starts.
+  // Otherwise warm up a fresh decoder on the tail of the previous chunk.
+  std::vector<const P2d_rec *> warmup;
+  if (_chunks.empty())
+  {
+    chunk->boundary = _state;
+    chunk->exact = true;
+  }
+  else
+    warmup.swap(_warmup);
+
+  /* The next chunk's warmup starts a few records ahead of the last second
+   * in this one, so the warm decoder crosses a second and picks up tas.
+   */
+  const std::vector<const P2d_rec *> & recs = chunk->records;
+  size_t n = recs.size() - 1;
+  while (n > 0 && recs.size() - n < maxWarmupRecords && sameSecond(recs[n-1], recs.back()))
+    --n;
+  n = (n > warmupRecords) ? n - warmupRecords : 0;
+  _warmup.assign(recs.begin() + n, recs.end());
+
+  Chunk *c = chunk.get();
+  _chunks.push_back(chunk);
+  _pending.push_back(_pool->Submit([this, c, warmup = std::move(warmup)]() {
+    std::vector<unsigned char> image_buff(CIPDecoder::bufferSize);
+    if (!c->exact)
+    {
+      std::vector<DecodedParticle> discard;
+      decode(c->boundary, warmup.data(), warmup.size(), discard, &image_buff[0]);
+    }
+    c->end = c->boundary;
+    if (!c->exact)
+      c->end.cip.Mark();
+    c->nRecords = decode(c->end, c->records.data(), c->records.size(), c->particles, &image_buff[0]);
+  }));
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::collectChunk()
+{
+  std::shared_ptr<Chunk> chunk = _chunks.front();
+  _chunks.pop_front();
+  _pending.front().get();
+  _pending.pop_front();
+
+  if (_state.done)	// An earlier chunk reached the end time.
+    return;
+
+  /* The decode state is fully determined once a sync word has been seen in
+   * each of the same few records, so a warmed up decoder normally matches
+   * the state the previous chunk ended with.  When it does not (particle
+   * straddling the whole warmup, no second crossed for tas, a CIP time
+   * word from stale data older than the warmup), decode the chunk again
+   * here from the exact state.  Either way the output is the same as a
+   * serial pass.
+   */
+  if (!chunk->exact && (!(chunk->boundary == _state) || chunk->end.cip.Inherited()))
+  {
+    chunk->particles.clear();
+    chunk->end = _state;
+    chunk->nRecords = decode(chunk->end, chunk->records.data(), chunk->records.size(),
+				chunk->particles, _image_buff);
+  }
+  else
+  if (!chunk->exact)
+    chunk->end.cip.Rebase(_state.cip);
+
+  _buffcount += chunk->nRecords;
+  accumulate(chunk->particles);
+  _state = std::move(chunk->end);
+
+  if (_state.done)
+  {
+    cout << "\n2D record time exceeds netCDF time, exiting loop.\n";
+    _done = true;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+bool ProbeProcessor::ProcessRecord(const P2d_rec & buffer)
+{
+  std::vector<DecodedParticle> particles;
+
+  if (_done)
+    return false;
+
+  const P2d_rec *rec = &buffer;
+  _buffcount += decode(_state, &rec, 1, particles, _image_buff);
+  accumulate(particles);
+
+  if (_state.done)
+  {
+    cout << "\n2D record time exceeds netCDF time, exiting loop.\n";
+    _done = true;
+    return false;
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+// Records in a mapped file need not be aligned.
+static inline uint64_t load64(const unsigned char *p)
+{
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+/* -------------------------------------------------------------------- */
+/* Probe families, the template argument of decodeFamily().  Each gives the
+ * slice layout, which bytes of a sync slice hold the sync pattern (for
+ * findSyncSlices()), and how to read the time word and DOF flag, for one
+ * kind of probe.
+ */
+namespace {
+
+// SPEC 2DS, HVPS, 3V-CPI; 128 diodes stored little-endian, sync in the far 3 bytes.
+struct SPECFamily
+{
+  static const int bytesPerSlice = 16;
+  static const bool lastByteFirst = true, rle = false, timeInNextSlice = false;
+
+  static const uint32_t syncBytes = 0xE000;	// Far 3 bytes.
+  static uint64_t timeline(const unsigned char *s, const ProbeInfo & probe)
+  { return load64(s) & probe.timingMask; }
+  static bool dofReject(const unsigned char *, const ProbeInfo &) { return false; }
+};
+
+// DMT CIP/PIP; 64 diodes, run length encoded, a full sync slice followed by the time slice.
+struct CIPFamily
+{
+  static const int bytesPerSlice = 8;
+  static const bool lastByteFirst = true, rle = true, timeInNextSlice = true;
+
+  static const uint32_t syncBytes = 0xFF;	// Whole slice.
+  static uint64_t timeline(const unsigned char *s, const ProbeInfo &)
+  { return CIPTimeWord_Microseconds(load64(s)); }
+  static bool dofReject(const unsigned char *s, const ProbeInfo & probe)
+  { return s[7] & probe.dofMask; }
+};
+
+// Fast2D C/P; 64 diodes stored big-endian, sync in the near 2 bytes.
+struct Fast2DFamily
+{
+  static const int bytesPerSlice = 8;
+  static const bool lastByteFirst = false, rle = false, timeInNextSlice = false;
+
+  static const uint32_t syncBytes = 0x03;	// Near 2 bytes.
+  static uint64_t timeline(const unsigned char *s, const ProbeInfo & probe)
+  { return endianswap_ull(load64(s)) & probe.timingMask; }
+  static bool dofReject(const unsigned char *s, const ProbeInfo & probe)
+  { return s[2] & probe.dofMask; }
+};
+
+// Legacy 32 diode PMS 2D, big-endian, same sync convention as Fast2D.
+struct Legacy32Family
+{
+  static const int bytesPerSlice = 4;
+  static const bool lastByteFirst = false, rle = false, timeInNextSlice = false;
+
+  static const uint32_t syncBytes = 0x03;	// Near 2 bytes.
+  static uint64_t timeline(const unsigned char *s, const ProbeInfo & probe)
+  {
+    uint32_t x;
+    memcpy(&x, s, sizeof(x));
+    return ntohl(x) & probe.timingMask;
+  }
+  static bool dofReject(const unsigned char *, const ProbeInfo &) { return false; }
+};
+
+}
+
+/* -------------------------------------------------------------------- */
+ProbeProcessor::DecodeFunc ProbeProcessor::selectDecoder(const ProbeInfo & probe)
+{
+  if (probe.id[0] == '3' || probe.id[0] == 'S' || probe.id[0] == 'H')
+    return &ProbeProcessor::decodeFamily<SPECFamily>;
+  if (probe.id[1] == '8')	// CIP or PIP
+    return &ProbeProcessor::decodeFamily<CIPFamily>;
+  if (probe.nDiodes == 32)
+    return &ProbeProcessor::decodeFamily<Legacy32Family>;
+  return &ProbeProcessor::decodeFamily<Fast2DFamily>;
+}
+
+/* -------------------------------------------------------------------- */
+template <class Family>
+int ProbeProcessor::decodeFamily(DecodeState & state, const P2d_rec * const recs[], int nRecs,
+		std::vector<DecodedParticle> & out, unsigned char *image_buff) const
+{
+  const int bytesPerSlice = Family::bytesPerSlice;
+  uint64_t timeline = 0, difftimeline;
+  double freq;
+  int nProcessed = 0;
+
+  int maxSlices = state.roi.maxSlices();
+  static thread_local std::vector<int> syncs;
+  Profile *profile = _profile.get();
+  Profile::Timer decodeTimer(profile, Profile::DECODE);
+
+  for (int irec = 0; irec < nRecs && !state.done; ++irec)
+  {
+  const P2d_rec & buffer = *recs[irec];
+
+  // Uncompress data buffer, uncompressed images are used where they are.
+  int nSlices = sizeof(buffer.image) / bytesPerSlice;
+  const unsigned char *image = buffer.image;
+  if constexpr (Family::rle) {
+    Profile::Timer timer(profile, Profile::RLE);
+    nSlices = state.cip.Decode(buffer.image, sizeof(buffer.image), image_buff, image);
+  }
+
+
+  /* set next buffer time.  3V-CPI will decompress into many buffers with
+   * same time stamp.  don't assign lastbuffertime until we have processed
+   * all of them.
+   */
+  {
+  double newbuffertime = TwoDtime(&buffer) + ((double)ntohs(buffer.msec) / 1000);
+  if (newbuffertime != state.buffertime)
+  {
+    state.firsttimeflag = true;
+    state.lastbuffertime = state.buffertime;
+    state.buffertime = newbuffertime;
+  }
+  }
+
+  // Record first buffer day for midnight crossings, do not process first record.
+  if (state.firstRecord)
+  {
+    state.last_time1hz = (long)state.buffertime;
+    state.firstRecord = false;
+    ++nProcessed;
+    continue;
+  }
+
+  if (state.buffertime >= _cfg.stoptime)
+  {
+    state.done = true;
+    break;
+  }
+
+
+  if (_cfg.debug)
+    cout << "New buffer : " << fixed << state.buffertime << " msec=" << ntohs(buffer.msec) << endl;
+
+
+  /* Find all the sync slices first, and take the slices between them as
+   * whole particle images.
+   */
+  findSyncSlices(image, nSlices, bytesPerSlice, Family::syncBytes, syncs);
+  syncs.push_back(nSlices);
+  int limit = min(nSlices, maxSlices)-1;	// Limit slice_count to 511
+
+  int islice = 0;
+  for (int next : syncs)
+  {
+     // Image slices up to the next sync, make them part of binary image.
+     if (islice < next)
+     {
+        Profile::Timer timer(profile, Profile::SIZE);
+
+        if (state.slice_count > limit)	// Short CIP buffer cut the particle back.
+        {
+          state.features.Start();
+          for (int i = 0; i < limit; ++i)
+            state.features.AddSlice(state.roi.row(i));
+          state.slice_count = limit;
+        }
+
+        // Unpack the slices that fit all at once, the rest are dropped.
+        int n = min(next - islice, limit - state.slice_count);
+        unpackSlices(&image[islice*bytesPerSlice], n, bytesPerSlice, Family::lastByteFirst,
+		state.roi.row(state.slice_count));
+        for (int i = 0; i < n; ++i)
+          state.features.AddSlice(state.roi.row(state.slice_count + i));
+        state.slice_count += n;
+        islice = next;
+     }
+
+     if (next == nSlices)
+       break;
+     if (next < islice)		// CIP time slice that looks like a sync.
+       continue;
+
+     // Found a sync line
+     const unsigned char *slice = &image[islice*bytesPerSlice];
+     {
+        DecodedParticle dp;
+
+        if constexpr (Family::timeInNextSlice) {
+           // Past the end of the buffer the time word is whatever was left there.
+           if (islice+1 >= nSlices)
+             slice = state.cip.PastEnd(nSlices);
+           else
+             slice += bytesPerSlice;
+           ++islice;
+        }
+
+        timeline = Family::timeline(slice, _probe);
+        bool dofReject = Family::dofReject(slice, _probe);
+
+        if (state.firsttimeflag) {
+           state.firsttimeline = timeline;
+           state.firsttimeflag = false;
+        }
+
+        // Look for negative interarrival time, set to zero instead
+        if (timeline < state.firsttimeline) difftimeline = 0;
+        else difftimeline = timeline - state.firsttimeline;
+
+        freq = _probe.resolution / (1.0e6 * state.tas);
+        if (_probe.clockType == ProbeInfo::FIXED)
+          difftimeline /= _probe.clockMhz;
+        else
+          difftimeline *= freq;
+
+        // Process the roi
+        long time1hz = min((long)(state.lastbuffertime + difftimeline), (long)state.buffertime);
+
+        dp.sized = (time1hz >= _cfg.starttime);
+        if (dp.sized) {
+           Profile::Timer timer(profile, Profile::SIZE);
+           state.particle = state.features.Finish(_probe.resolution, _cfg.smethod);
+           state.particle.inttime = timeline - state.lasttimeline;
+           if (_probe.clockType == ProbeInfo::FIXED)
+             state.particle.inttime /= _probe.clockMhz;
+           else
+             state.particle.inttime *= freq;
+
+           state.particle.time1hz=time1hz;
+           state.particle.dofReject = dofReject;
+        }
+
+        // Debugging output, roi with the holes filled in.
+        if (_cfg.debug) {
+           if (dp.sized) {
+             Profile::Timer timer(profile, Profile::FILLHOLES);
+             fillholes2(state.roi, state.slice_count);
+           }
+           cout<<islice<<endl;
+           showparticle(state.particle);
+           showroi(state.roi, state.slice_count);
+        }
+
+        // Check the particle time to see if a new 1-s period has been crossed.
+        dp.particle = state.particle;
+        dp.time1hz = time1hz;
+        dp.completed = state.last_time1hz;
+        dp.crossed = (time1hz != state.last_time1hz);
+        dp.tas = (float)ntohs(buffer.tas);
+        if (dp.crossed) {
+           if (!_hasTASX && state.last_time1hz >= _cfg.starttime)
+             state.tas = dp.tas;
+           state.last_time1hz = time1hz;
+        }
+        out.push_back(dp);
+
+        // Start a new particle
+        state.lasttimeline = timeline;
+        state.slice_count = 0;
+        state.features.Start();
+     } // end of image processing after detection of sync line
+
+     ++islice;
+  } // end slice loop
+
+  ++nProcessed;
+  }
+
+  return nProcessed;
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::accumulate(const std::vector<DecodedParticle> & particles)
+{
+  for (const DecodedParticle & dp : particles)
+  {
+    if (_cache)
+      _cache->Append(&dp);
+
+    if (_profile) {
+      _profile->syncWords++;
+      _profile->particles += dp.sized;
+    }
+
+    // Update interarrival queue
+    if (dp.sized) {
+      addInterarrival(_itq[_iitq], -1);
+      addInterarrival(dp.particle.inttime, 1);
+      _itq[_iitq]=dp.particle.inttime;
+      _iitq++;
+      if (_iitq > (nitq-1)) _iitq=0;
+    }
+
+    // If a new 1-s period has been crossed, place all particles in count matrix
+    if (dp.crossed) {
+      processSecond(dp);
+
+      // Restart particle stack
+      _particle_stack.clear();
+    }
+
+    // Add this particle to vector
+    _particle_stack.push_back(dp.particle);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::addInterarrival(double inttime, int n)
+{
+  if (inttime < _it_endpoints[_cfg.nInterarrivalBins])  // This should be the largest time allowable
+    _itHist[_itBins(inttime)] += n;
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::processSecond(const DecodedParticle & dp)
+{
+  long itime = dp.completed - _cfg.starttime;  // time index
+
+  // Make sure particles are in correct time range
+  if (itime < 0 || itime >= _numtimes)
+    return;
+
+  // Streaming, write out the oldest seconds to make room.
+  while (itime >= _base + _window)
+    flushBlock();
+
+  if (itime < _base) {	// Time went backwards past what was written out.
+    _lateSeconds++;
+    return;
+  }
+
+  long irow = itime - _base;  // row in the count and data arrays
+
+  // Time went backwards, this adds to the rows of a second still out.
+  for (const auto & sec : _seconds)
+    if (sec->irow == irow) {
+      drainSeconds();
+      break;
+    }
+
+  if (_hasTASX == false)
+    _sets[0]->data.tas[irow] = dp.tas;
+
+  //Interarrival time array, queue version
+  for (int i = 0; i < _cfg.nInterarrivalBins; i++)
+    _count_it[irow][i+binoffset] += _itHist[i];   //Add offset to iit for RAF convention
+
+  // Reuse a retired Second, its particle batch becomes the new stack.
+  std::shared_ptr<Second> sec;
+  if (_spareSeconds.empty())
+    sec = std::make_shared<Second>();
+  else {
+    sec = _spareSeconds.back();
+    _spareSeconds.pop_back();
+    sec->fitStats = FitStats();
+    sec->rejectStats = RejectStats();
+  }
+
+  sec->itime = itime;
+  sec->irow = irow;
+  sec->time1hz = dp.time1hz;
+  sec->nextit = dp.particle.inttime;
+  sec->fitspec.assign(&_count_it[irow][binoffset], &_count_it[irow][binoffset] + _cfg.nInterarrivalBins);
+  std::swap(sec->particles, _particle_stack);
+
+  double counts = 0;
+  for (float c : sec->fitspec)
+    counts += c;
+
+  /* Each second's fit starts from scratch and bins into its own rows, so
+   * seconds can go to the thread pool.  Except with -warmstart, or too few
+   * counts to fit, where the last second's fit carries over; those are done
+   * here once everything before them is finished.
+   */
+  if (_pool == 0 || _cfg.warmStart || counts < dpoissonMinCounts)
+  {
+    drainSeconds();
+    std::copy(_bestfit, _bestfit+3, sec->bestfit);
+    sec->warmStart = _cfg.warmStart && _fitStats.lastConverged;
+    fitAndBin(*sec);
+    retire(sec);
+    return;
+  }
+
+  if (_seconds.size() >= maxSeconds)
+    retireSecond();
+
+  Second *s = sec.get();
+  s->warmStart = false;
+  _seconds.push_back(sec);
+  _secondsPending.push_back(_pool->Submit([this, s]() { fitAndBin(*s); }));
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::fitAndBin(Second & sec)
+{
+  long irow = sec.irow;
+  ProbeData & data = _sets[0]->data;
+
+  {
+  Profile::Timer timer(_profile.get(), Profile::FIT);
+  dpoisson_fit(_it_midpoints, sec.fitspec, sec.bestfit, sec.warmStart, &sec.fitStats);
+  }
+  data.cpoisson1[irow]=(float)sec.bestfit[0];  //Save factors
+  data.cpoisson2[irow]=(float)sec.bestfit[1];
+  data.cpoisson3[irow]=(float)sec.bestfit[2];
+
+  // Compute shattering corrections if flagged
+  if (_cfg.shattercorrect) {
+    data.pcutoff[irow]=(float)(1.0/sec.bestfit[1]*0.05);  // Compute cutoff time
+    data.corrfac[irow]=(float)(1.0/(2*exp(-data.pcutoff[irow]*sec.bestfit[1])-1));  //Compute correction factor
+  } else {
+    data.pcutoff[irow]=0;   // No rejection or corrections
+    data.corrfac[irow]=1.0;
+  }
+
+  for (size_t s = 1; s < _sets.size(); s++) {
+    ProbeData & other = _sets[s]->data;
+    other.tas[irow] = data.tas[irow];
+    other.cpoisson1[irow] = data.cpoisson1[irow];
+    other.cpoisson2[irow] = data.cpoisson2[irow];
+    other.cpoisson3[irow] = data.cpoisson3[irow];
+    other.pcutoff[irow] = data.pcutoff[irow];
+    other.corrfac[irow] = data.corrfac[irow];
+  }
+
+  /* Reject and bin the stack into each set, a column at a time.  The
+   * water correction is the same for each set, so only done once.
+   */
+  static thread_local std::vector<float> nextit, wc, ones;
+  static thread_local std::vector<uint8_t> flags;
+  ParticleBatch & batch = sec.particles;
+  size_t n = batch.size();
+
+  if (n == 0)
+    return;
+
+  Profile::Timer timer(_profile.get(), Profile::BIN);
+
+  // Interarrival of the particle after.  The last one's is the particle for the next time period.
+  nextit.resize(n);
+  std::copy(batch.inttime.begin()+1, batch.inttime.end(), nextit.begin());
+  nextit[n-1] = sec.nextit;
+  wc.clear();
+
+  for (size_t s = 0; s < _sets.size(); s++) {
+     SizingSet & set = *_sets[s];
+     const float *cwc;
+
+     //Find water size correction
+     if (set.smethod == Config::EQUIV_AREA_DIAM) {
+        ones.assign(n, 1.0);
+        cwc = ones.data();
+     } else {
+        if (wc.empty()) {
+          wc.resize(n);
+          water_corrections(batch, wc.data());
+        }
+        cwc = wc.data();
+     }
+
+     // The first set's results stay with the particles, the other sizing
+     // and acceptance methods' are scratch.
+     const float *size = (s == 0) ? batch.size_.data() : batch.sizes(set.smethod).data();
+     flags.resize(n);
+     uint8_t *f = (s == 0) ? batch.flags.data() : flags.data();
+
+     reject_particles(batch, size, nextit.data(), cwc, set.data.pcutoff[irow],
+		set.probe.resolution, set.probe.bin_endpoints[0],
+		set.probe.bin_endpoints[set.probe.numBins], set.eawmethod, f,
+		(s == 0 && _profile) ? &sec.rejectStats : 0);
+     binSecond(set, irow, n, size, cwc, f);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::retire(const std::shared_ptr<Second> & s)
+{
+  Second & sec = *s;
+
+  _fitStats.add(sec.fitStats);
+  if (_profile)
+    _profile->rejects.add(sec.rejectStats);
+  std::copy(sec.bestfit, sec.bestfit+3, _bestfit);
+
+  if (_cfg.verbose) cout<<sec.itime+_cfg.starttime<<" "<<sec.time1hz<<" "<<sec.particles.size()<<" "<<_bestfit[0]<<" "<<_bestfit[1]<<" "<<_bestfit[2]<<endl;
+
+  if (_cfg.debug) cout << "particle stack size : " << sec.particles.size() << endl;
+  if (_cfg.debug)
+    for (size_t i = 0; i < sec.particles.size(); i++)
+      showparticle(sec.particles[i]);
+  if (_particleFile)
+    _particleColumns.Add(sec.particles, sec.itime);
+
+  if (_particleColumns.size() >= ParticleFile::chunkParticles)
+    flushParticles();
+
+  sec.particles.clear();
+  _spareSeconds.push_back(s);
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::retireSecond()
+{
+  std::shared_ptr<Second> sec = _seconds.front();
+  _seconds.pop_front();
+  _secondsPending.front().get();
+  _secondsPending.pop_front();
+
+  retire(sec);
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::drainSeconds()
+{
+  while (!_seconds.empty())
+    retireSecond();
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::binSecond(SizingSet & set, long irow, size_t n, const float size[],
+		const float wc[], const uint8_t flags[])
+{
+  float *count_all = set.count_all[irow] + binoffset;	//Add offset to bin for RAF convention
+  float *count_round = set.count_round[irow] + binoffset;
+  long all = 0, round = 0;
+
+  // Fill count arrays with accepted particles
+  for (size_t i = 0; i < n; i++) {
+     if (!(flags[i] & ParticleBatch::IREJECT)) {
+        count_all[set.probe.FindBin(size[i])]++;
+        all++;
+     }
+     if (!(flags[i] & ParticleBatch::WREJECT)) {
+        count_round[set.probe.FindBin(size[i]/wc[i])]++;
+        round++;
+     }
+  }
+
+  set.data.all.accepted[irow] += all;
+  set.data.all.rejected[irow] += n - all;
+  set.data.round.accepted[irow] += round;
+  set.data.round.rejected[irow] += n - round;
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::flushParticles()
+{
+  if (_particleFile == 0 || _particleColumns.size() == 0)
+    return;
+
+  // The writer thread writes them, with the rest of the netCDF output.
+  std::shared_ptr<ParticleFile::Columns> cols =
+	std::make_shared<ParticleFile::Columns>(std::move(_particleColumns));
+  _particleColumns.clear();
+  _ncfile.Post([this, cols]()
+  {
+    std::lock_guard<std::mutex> lock(_ncfile.lock());
+    _particleFile->Write(_probe, *cols);
+  });
+}
+
+/* -------------------------------------------------------------------- */
+bool ProbeProcessor::UseCache(const RecordFile & file)
+{
+  FeatureCache::Key key;
+  memset(&key, 0, sizeof(key));
+  key.fileSize = file.size();
+  key.fileMtime = file.mtime();
+  memcpy(key.probeId, _probe.id.c_str(), sizeof(key.probeId));
+  key.nDiodes = _probe.nDiodes;
+  key.resolution = _probe.resolution;
+  key.hasTASX = _hasTASX;
+  key.starttime = _cfg.starttime;
+  key.stoptime = _cfg.stoptime;
+  key.recordSize = sizeof(DecodedParticle);
+
+  std::unique_ptr<FeatureCache> cache(new FeatureCache(_cfg.inputFile, _probe.id));
+
+  if (cache->OpenRead(key, [&file]() { return file.Hash(); }))
+  {
+    cout << "Using particle cache " << cache->fileName() << ", "
+	<< cache->size() << " particles.\n";
+    replayCache(*cache);
+    _buffcount = cache->nRecords();
+    _done = true;
+    return true;
+  }
+
+  // A new cache is built from a full pass over the file anyway.
+  key.fileHash = file.Hash();
+  if (cache->Create(key))
+    _cache = std::move(cache);
+  else
+    cerr << "process2d: Unable to create particle cache " << cache->fileName() << endl;
+
+  return false;
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::replayCache(FeatureCache & cache)
+{
+  static const size_t blockParticles = 65536;
+  std::vector<DecodedParticle> particles(blockParticles);
+  size_t n;
+
+  while ((n = cache.Read(particles.data(), blockParticles)) > 0)
+  {
+    particles.resize(n);
+
+    // Sizing method may differ from the run that made the cache.  Empty
+    // images are not sized, see ParticleFeatures::Finish().
+    for (DecodedParticle & dp : particles)
+      if (dp.particle.csize > 0)
+        dp.particle.size = particle_size(dp.particle, _cfg.smethod);
+
+    accumulate(particles);
+    particles.resize(blockParticles);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::ComputeDerived()
+{
+  drainSeconds();
+  flushParticles();
+
+  if (_cache)
+  {
+    if (_cache->Commit(_buffcount) == 0)
+      cout << "\nWrote particle cache " << _cache->fileName() << ".";
+    else
+      cerr << "\nprocess2d: Failed to write particle cache " << _cache->fileName() << endl;
+    _cache.reset();
+  }
+
+  // Streaming; seconds at the end with no data may not fit in the window yet.
+  while (_numtimes - _base > _window)
+    flushBlock();
+
+  cout << "\nApplying Blankouts...";
+  cout << "\nComputing derived parameters...";
+  computeDerivedRows(0, rowsLeft());
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::computeDerivedRows(int first, int n)
+{
+  if (_pool == 0)
+  {
+    for (auto & set : _sets)
+      computeDerived(*set, first, n);
+    return;
+  }
+
+  // Rows are independent.
+  const int blockRows = 1024;
+  std::vector<std::future<void> > blocks;
+  for (auto & set : _sets)
+    for (int i = first; i < first+n; i += blockRows)
+    {
+      SizingSet *s = set.get();
+      int count = std::min(blockRows, first+n-i);
+      blocks.push_back(_pool->Submit([this, s, i, count]() { computeDerived(*s, i, count); }));
+    }
+
+  for (auto & block : blocks)
+    block.get();
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::computeDerived(SizingSet & set, int first, int n)
+{
+  Profile::Timer timer(_profile.get(), Profile::DERIVED);
+
+  // Apply blankouts from $PROJ_DIR/$PROJECT/$PLATFORM/Production/BlankOAP.rf##
+  for (size_t p = 0; p < set.probe.blank_out.size(); ++p)
+  {
+    int	start_blank = set.probe.blank_out[p].first - _cfg.starttime - _base,
+	end_blank = set.probe.blank_out[p].second - _cfg.starttime - _base;
+    for (int i = first; i < first+n; i++)
+    {
+      if (i >= start_blank && i <= end_blank)
+      {
+        for (int bin = binoffset; bin < set.probe.numBins+binoffset; bin++)
+          set.count_all[i][bin] = set.count_round[i][bin] = nan("");
+      }
+    }
+  }
+
+
+  // Compute sample volume, concentration, total number, and LWC
+
+  float zFac[set.probe.numBins], dia2[set.probe.numBins], dia3[set.probe.numBins];
+  for (int i = 0; i < set.probe.numBins; i++) {
+    zFac[i] = pow((double)set.probe.bin_midpoints[i] / 1000.0, 6.0);
+    dia2[i] = set.probe.bin_midpoints[i] * set.probe.bin_midpoints[i];
+    dia3[i] = pow((double)set.probe.bin_midpoints[i], 3.0);
+  }
+
+  // Compute
+  for (int i = first; i < first+n; i++)
+  {
+    float dbar2_all = 0.0, dbar2_round = 0.0;
+    float z_all = 0.0, z_round = 0.0;
+
+    for (int bin = binoffset; bin < set.probe.numBins+binoffset; bin++)
+    {
+      if (set.data.tas[i] > 0.0) {
+        float sv = set.probe.samplearea[bin-binoffset] * set.data.tas[i];  // Sample volume (m3)
+
+        // Correct counts for the poisson fitting
+        if (std::isnan(set.data.corrfac[i])) set.data.corrfac[i]=1.0;  //Filter out bad correction factors
+        set.count_all[i][bin] *= set.data.corrfac[i];
+        set.count_round[i][bin] *= set.data.corrfac[i];
+        set.conc_all[i][bin] = set.count_all[i][bin] / sv / 1000.0;	// #/L
+        set.conc_round[i][bin] = set.count_round[i][bin] / sv / 1000.0;	// #/L
+
+        if (bin >= 4) { // 100 um and larger (for 2DC).
+          set.data.all.total_conc100[i] += set.conc_all[i][bin];
+          set.data.round.total_conc100[i] += set.conc_round[i][bin];
+        }
+
+        if (bin >= 6) { // 150 um and larger (for 2DC).
+          set.data.all.total_conc150[i] += set.conc_all[i][bin];
+          set.data.round.total_conc150[i] += set.conc_round[i][bin];
+        }
+
+        if (bin >= set.probe.firstBin) {
+          set.data.all.total_conc[i] += set.conc_all[i][bin];
+          set.data.all.dbar[i]	+= set.conc_all[i][bin] * set.probe.bin_midpoints[bin-binoffset];
+          dbar2_all		+= set.conc_all[i][bin] * dia2[bin-binoffset];
+          set.data.all.lwc[i]	+= set.conc_all[i][bin] * dia3[bin-binoffset];
+          z_all			+= set.conc_all[i][bin] * zFac[bin-binoffset];
+
+          set.data.round.total_conc[i] += set.conc_round[i][bin];
+          set.data.round.dbar[i]	+= set.conc_round[i][bin] * set.probe.bin_midpoints[bin-binoffset];
+          dbar2_round		+= set.conc_round[i][bin] * dia2[bin-binoffset];
+          set.data.round.lwc[i]	+= set.conc_round[i][bin] * dia3[bin-binoffset];
+          z_round		+= set.conc_round[i][bin] * zFac[bin-binoffset];
+        }
+        else
+          set.conc_all[i][bin] = set.conc_round[i][bin] = 0.0;
+      }
+    }
+
+    if (z_all > 0.0)
+      set.data.all.dbz[i] = 10.0 * log10((double)(z_all * 1.0e3));
+
+    if (z_round > 0.0)
+      set.data.round.dbz[i] = 10.0 * log10((double)(z_round * 1.0e3));
+
+    if (set.data.all.total_conc[i] > 0.0001) {
+      set.data.all.dbar[i] /= set.data.all.total_conc[i];
+
+      set.data.all.disp[i] = (float)sqrt(fabs((double)(dbar2_all /
+                        set.data.all.total_conc[i] - set.data.all.dbar[i] *
+                        set.data.all.dbar[i]))) / set.data.all.dbar[i];
+    }
+
+    if (set.data.round.total_conc[i] > 0.0001) {
+      set.data.round.dbar[i] /= set.data.round.total_conc[i];
+
+      set.data.round.disp[i] = (float)sqrt(fabs((double)(dbar2_round /
+                        set.data.round.total_conc[i] - set.data.round.dbar[i] *
+                        set.data.round.dbar[i]))) / set.data.round.dbar[i];
+    }
+
+    if (dbar2_all > 0.0)
+      set.data.all.eff_rad[i] = 0.5 * (set.data.all.lwc[i] / dbar2_all);
+
+    if (dbar2_round > 0.0)
+      set.data.round.eff_rad[i] = 0.5 * (set.data.round.lwc[i] / dbar2_round);
+
+    set.data.all.lwc[i] *= M_PI / 6.0 * 1.0e-9;
+    set.data.round.lwc[i] *= M_PI / 6.0 * 1.0e-9;
+  }
+
+
+  //=============Replace NAN with missing value (-32767) =====================
+  set.data.ReplaceNANwithMissingData(first, n);
+  for (int i = first; i < first+n; i++)
+  {
+    for (int bin = binoffset; bin < set.probe.numBins+binoffset; bin++)
+    {
+      if (std::isnan(set.count_all[i][bin]))
+        set.count_all[i][bin] = set.conc_all[i][bin] = -32767.0;
+      if (std::isnan(set.count_round[i][bin]))
+        set.count_round[i][bin] = set.conc_round[i][bin] = -32767.0;
+    }
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::flushBlock()
+{
+  int n = _window / 2;
+
+  drainSeconds();
+  computeDerivedRows(0, n);
+
+  // The writer thread writes a copy, the window moves on now.
+  std::shared_ptr<Block> block = makeBlock(n, true);
+  _ncfile.Post([this, block]()
+  {
+    std::lock_guard<std::mutex> lock(_ncfile.lock());
+    if (_cfg.verbose)
+      cout << "Writing " << _probe.id << " seconds " << block->base << " to "
+		<< block->base+block->n-1 << endl;
+    if (writeBlock(*block) == 0)
+      _ncfile.ncid()->sync();
+    else
+      cerr << "Error writing probe " << _probe.id << " to netCDF file." << endl;
+  });
+
+  // Slide the window down and start the freed rows over.
+  size_t rowLen = _probe.numBins+binoffset, itLen = _cfg.nInterarrivalBins+binoffset;
+  size_t keep = _window - n;
+  for (auto & set : _sets)
+  {
+    for (float *block : { set->count_all[0], set->count_round[0], set->conc_all[0], set->conc_round[0] })
+    {
+      memmove(block, block + n*rowLen, sizeof(float) * keep*rowLen);
+      memset((void *)(block + keep*rowLen), 0, sizeof(float) * n*rowLen);
+    }
+    set->data.Shift(n);
+  }
+  memmove(_count_it[0], _count_it[0] + n*itLen, sizeof(int) * keep*itLen);
+  memset((void *)(_count_it[0] + keep*itLen), 0, sizeof(int) * n*itLen);
+  _base += n;
+
+  if (_hasTASX && _base + (long)keep < _numtimes)
+  {
+    long first = _base + keep, count = std::min((long)n, _numtimes - first);
+    for (auto & set : _sets)
+      std::copy(_tasx.begin() + first, _tasx.begin() + first + count, set->data.tas.begin() + keep);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+int ProbeProcessor::Write()
+{
+  //=============Write to netCDF==============================================
+  if (_buffcount <= 1 && !_defined) return 1;  //Don't write empty files
+
+  if (_lateSeconds)
+    cerr << "Probe " << _probe.id << ": " << _lateSeconds
+	<< " seconds arrived after being written out, dropped; increase -stream." << endl;
+
+  std::lock_guard<std::mutex> lock(_ncfile.lock());
+  cout << "\nWriting to netCDF file";
+  int rc = writeBlock(*makeBlock(rowsLeft(), false));
+  cout << endl;
+  return rc;
+}
+
+/* -------------------------------------------------------------------- */
+void ProbeProcessor::ReportProfile(std::ostream & out) const
+{
+  if (_profile)
+    _profile->Report(out, _probe.serialNumber + _probe.suffix, _buffcount,
+		(long)_buffcount * sizeof(P2d_rec), &_fitStats);
+}
+
+/* -------------------------------------------------------------------- */
+std::string ProbeProcessor::varName(const char *base, const SizingSet & set) const
+{
+  string varname = base + set.probe.suffix; varname[3] = _probe.id[0];
+  return varname;
+}
+
+/* -------------------------------------------------------------------- */
+int ProbeProcessor::defineVariables()
+{
+  _ncfile.CreateNetCDFfile(_cfg);	// Output file; Create as necessary.
+  NcFile *dataFile = _ncfile.ncid();
+
+  _ncfile.CreateDimensions(_numtimes, _probe, _cfg);
+
+  // Define the variables.
+  NcVar timevar, a2dr, a2da, c2dr, c2da, iaep, i2d;
+  string varname;
+
+  if ((timevar = _ncfile.addTimeVariable(_cfg, _numtimes)).isNull())
+    return NetCDF::NC_ERR;
+
+  varname = "interarrival_endpoints";
+  if ((iaep = dataFile->getVar(varname)).isNull()) {
+    iaep = dataFile->addVar(varname, ncFloat, _ncfile.intbindim());
+  }
+
+  for (auto & set : _sets)
+  {
+    string eawmethodname;
+
+    // Full name for the various effective array width choices
+    if (set->eawmethod == Config::RECONSTRUCTION) eawmethodname = "Reconstruction";
+    if (set->eawmethod == Config::ENTIRE_IN) eawmethodname = "All-in";
+    if (set->eawmethod == Config::CENTER_IN) eawmethodname = "Center-in";
+//    if (set->eawmethod == Config::EQUIV_AREA_DIAM) eawmethodname = "Equivalent Area Diameter";
+
+    // Counts.  These are not in the ProbeData class yet, hence they are written here. @todo
+    varname = varName("A2DCA", *set);
+    if (!(a2da = _ncfile.addHistogram(varname, set->probe, binoffset)).isNull())
+    {
+      _ncfile.putVarAttribute(a2da, "Rejected", "Roundness below 0.1, interarrival time below 1/20th of distribution peak");
+      _ncfile.putVarAttribute(a2da, "ParticleAcceptMethod", eawmethodname);
+      if (set != _sets[0])
+        _ncfile.putVarAttribute(a2da, "SizingMethod", Config::sizeMethodName(set->smethod));
+    }
+
+    varname = varName("A2DCR", *set);
+    if (!(a2dr = _ncfile.addHistogram(varname, set->probe, binoffset)).isNull())
+    {
+      _ncfile.putVarAttribute(a2dr, "Rejected", "Roundness below 0.5, interarrival time below 1/20th of distribution peak");
+      _ncfile.putVarAttribute(a2dr, "ParticleAcceptMethod", eawmethodname);
+      if (set != _sets[0])
+        _ncfile.putVarAttribute(a2dr, "SizingMethod", Config::sizeMethodName(set->smethod));
+    }
+
+    if (set == _sets[0])
+    {
+      varname = varName("I2DCA", *set);
+      if (!(i2d = _ncfile.addHistogram(varname, set->probe, binoffset)).isNull())
+      {
+        _ncfile.putVarAttribute(i2d, "CellSizes", _it_endpoints);
+        _ncfile.putVarAttribute(i2d, "CellSizeUnits", "seconds");
+      }
+    }
+
+    //Concentration
+    varname = varName("C2DCA", *set);
+    c2da = _ncfile.addHistogram(varname, set->probe, binoffset);
+
+    varname = varName("C2DCR", *set);
+    c2dr = _ncfile.addHistogram(varname, set->probe, binoffset);
+  }
+
+  if (!iaep.isNull()) iaep.putVar(&_it_endpoints[0]); //, _cfg.nInterarrivalBins+1);
+
+  return 0;
+}
+
+/* -------------------------------------------------------------------- */
+std::shared_ptr<ProbeProcessor::Block> ProbeProcessor::makeBlock(int n, bool copy) const
+{
+  auto block = std::make_shared<Block>();
+  size_t rowLen = _probe.numBins+binoffset, itLen = _cfg.nInterarrivalBins+binoffset;
+
+  block->base = _base;
+  block->n = n;
+  block->count_it = _count_it[0];
+
+  if (copy)
+  {
+    block->itRows.assign(_count_it[0], _count_it[0] + n*itLen);
+    block->count_it = block->itRows.data();
+    block->rows.resize(_sets.size() * 4 * n*rowLen);
+  }
+
+  float *to = block->rows.data();
+  for (auto & set : _sets)
+  {
+    Block::Rows rows = { set->count_all[0], set->count_round[0], set->conc_all[0],
+		set->conc_round[0], &set->data };
+
+    if (copy)
+    {
+      for (const float **from : { &rows.count_all, &rows.count_round, &rows.conc_all, &rows.conc_round })
+      {
+        to = std::copy(*from, *from + n*rowLen, to);
+        *from = to - n*rowLen;
+      }
+      block->data.emplace_back(set->data, n);
+      rows.data = &block->data.back();
+    }
+    block->sets.push_back(rows);
+  }
+
+  return block;
+}
+
+/* -------------------------------------------------------------------- */
+int ProbeProcessor::writeBlock(const Block & block)
+{
+  Profile::Timer timer(_profile.get(), Profile::WRITE);
+
+  if (!_defined)
+  {
+    if (defineVariables())
+      return NetCDF::NC_ERR;
+    _defined = true;
+  }
+
+  NcFile *dataFile = _ncfile.ncid();
+
+  // Rows 0..n-1 go out as seconds base...base+n-1.
+  int n = block.n;
+  vector<size_t> start = { (size_t)block.base, 0, 0 };
+  vector<size_t> count = { (size_t)n, 1, (size_t)(_probe.numBins+binoffset) };
+  vector<size_t> itCount = { (size_t)n, 1, (size_t)(_cfg.nInterarrivalBins+binoffset) };
+
+  NcVar i2d = dataFile->getVar(varName("I2DCA", *_sets[0]));
+  if (!i2d.isNull() && n > 0) i2d.putVar(start, itCount, block.count_it);
+
+  for (size_t k = 0; k < _sets.size(); ++k)
+  {
+    SizingSet *set = _sets[k].get();
+    const Block::Rows & rows = block.sets[k];
+    NcVar a2dr, a2da, c2dr, c2da;
+
+    a2da = dataFile->getVar(varName("A2DCA", *set));
+    a2dr = dataFile->getVar(varName("A2DCR", *set));
+    c2da = dataFile->getVar(varName("C2DCA", *set));
+    c2dr = dataFile->getVar(varName("C2DCR", *set));
+
+    if (n > 0)
+    {
+      if (!a2da.isNull()) a2da.putVar(start, count, rows.count_all);
+      if (!a2dr.isNull()) a2dr.putVar(start, count, rows.count_round);
+      if (!c2da.isNull()) c2da.putVar(start, count, rows.conc_all);
+      if (!c2dr.isNull()) c2dr.putVar(start, count, rows.conc_round);
+    }
+
+    int rc = _ncfile.WriteData(set->probe, *rows.data, block.base, n);
+    if (rc)
+      return rc;
+  }
+
+  return 0;
+}
@@ -0,0 +1,417 @@
+#ifndef _probeprocessor_h_
+#define _probeprocessor_h_
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <condition_variable>
+#include <cstdint>
+
+#include "config.h"
+#include "probe.h"
+#include "ProbeData.h"
+#include "particle.h"
+#include "record.h"
+#include "ParticleFile.h"
+#include "FeatureCache.h"
+#include "RecordFile.h"
+#include "CIPDecoder.h"
+#include "Profile.h"
+
+class NetCDF;
+class ThreadPool;
+
+extern int binoffset;
+
+
+/**
+ * Per probe processing context.  Holds everything process2d needs to carry
+ * from one record to the next for a single probe (ROI, particle stack,
+ * interarrival queue, count arrays), so that records for all probes can be
+ * routed here from one pass through the 2D file.
+ *
+ * Each processor may run on its own worker thread: Start() the thread,
+ * Push() records to it, then EndOfData() and Join().  Derived parameters
+ * are computed on the worker; Write() is left to the caller.  netCDF
+ * output, -particles included, is done by the writer thread, see
+ * NetCDF::Post(); anything else
+ * touching the file is serialized on NetCDF::lock().
+ *
+ * Count and data arrays hold a window of seconds starting at _base.  By
+ * default the window is the whole time range and everything is written at
+ * the end.  With Config::streamSeconds the window is twice that, and once
+ * a second arrives past its end the oldest streamSeconds are finished,
+ * copied out and queued for the writer (see flushBlock()), so memory stays
+ * bounded and a crash only loses the current window.
+ *
+ * Processing is done in three stages.  Decoding turns records into one
+ * DecodedParticle per sync word, and only depends on the DecodeState
+ * carried from the previous record.  Accumulation runs the interarrival
+ * queue in order and hands each completed Second to the fit, rejection
+ * and binning stage.  Given a thread pool, the worker splits its records
+ * into chunks ending on 1 second boundaries and decodes the chunks in
+ * parallel; see collectChunk() for how the chunk edges are stitched back
+ * together.  Seconds are fit and binned on the pool too, each into its own
+ * rows, and retired in order; see processSecond() for what has to wait.
+ */
+class ProbeProcessor
+{
+public:
+  ProbeProcessor(Config & cfg, NetCDF & ncfile, ProbeInfo & probe, ThreadPool *pool = 0,
+	ParticleFile *particleFile = 0);
+  ~ProbeProcessor();
+
+  /**
+   * Does this record belong to our probe.
+   */
+  bool Matches(const P2d_rec & rec) const
+  { return rec.probetype == _probetype && rec.probenumber == _probenumber; }
+
+  /**
+   * Process the next record for this probe.
+   * @returns false once the probe has passed the end time; further records
+   * should not be sent.
+   */
+  bool ProcessRecord(const P2d_rec & buffer);
+
+  bool Done() const { return _done; }
+
+  /**
+   * Start the worker thread.
+   */
+  void Start();
+
+  /**
+   * Queue a record for the worker thread.  Blocks while the queue is full.
+   * The record is not copied, it must stay put until the worker is done.
+   */
+  void Push(const P2d_rec *buffer);
+
+  /**
+   * No more records are coming; the worker finishes up the queue and
+   * computes the derived parameters.
+   */
+  void EndOfData();
+
+  /**
+   * Wait for the worker thread to finish.
+   */
+  void Join();
+
+  /**
+   * For the writer thread; the worker is finished and the blocks it
+   * streamed out are written.
+   */
+  bool Finished() const { return _finished; }
+
+  /**
+   * Apply blankouts and compute concentrations and derived parameters.
+   */
+  void ComputeDerived();
+
+  /**
+   * Write the results to the netCDF file.
+   * @returns 0 on success.
+   */
+  int Write();
+
+  /**
+   * Use a FeatureCache of the decoded particles, for -cache.  If there is a
+   * current one it is accumulated here and now, and the processor is Done();
+   * no records need to be sent.  Otherwise one is written as records are
+   * decoded, and committed by ComputeDerived().
+   * @returns true if the cache was used.
+   */
+  bool UseCache(const RecordFile & file);
+
+  ProbeInfo & probe() const { return _probe; }
+
+  const FitStats & fitStats() const { return _fitStats; }
+
+  /**
+   * Print the -profile report for this probe.
+   */
+  void ReportProfile(std::ostream & out) const;
+
+private:
+  /**
+   * Everything the decode stage carries from one record to the next.
+   */
+  struct DecodeState
+  {
+    DecodeState(int nRows, int nDiodes);
+
+    bool operator==(const DecodeState & rhs) const;
+
+    ParticleImage roi;		// slice_count rows in use.
+    int slice_count;
+    ParticleFeatures features;	// Of the slice_count rows, as they come in.
+
+    CIPDecoder cip;		// CIP/PIP decompression carry over between records.
+
+    uint64_t firsttimeline, lasttimeline;
+    double lastbuffertime, buffertime;
+    bool firsttimeflag;
+    float tas;
+    long last_time1hz;
+    Particle particle;
+    bool firstRecord;
+    bool done;
+  };
+
+  /**
+   * Decode stage output, one per sync word.
+   */
+  struct DecodedParticle
+  {
+    Particle particle;	// As it goes on the particle stack.
+    long time1hz;	// Second of this sync word.
+    long completed;	// Second just completed, if crossed.
+    bool crossed;	// Crossed into a new second; process the stack first.
+    bool sized;		// Particle was sized, add to interarrival queue.
+    float tas;		// Record true airspeed, for the completed second.
+  };
+
+  /**
+   * Histograms and derived data for one sizing / acceptance method.  The
+   * first set is the command line method and writes the usual variables;
+   * Config::extraMethods each get another set, binned from the same
+   * particles, with the method tag added to the variable suffix.
+   */
+  struct SizingSet
+  {
+    SizingSet(const ProbeInfo & p, Config::SizeMethod sm, Config::Method em,
+		const std::string & sfx, int rows);
+    ~SizingSet();
+
+    ProbeInfo probe;	// Copy with this set's suffix and sample area.
+    Config::SizeMethod smethod;
+    Config::Method eawmethod;
+
+    //Count and concentration arrays, pointers into contiguous blocks, one row per second of the window.
+    std::vector<float *> count_all, conc_all;
+    std::vector<float *> count_round, conc_round;
+
+    ProbeData data;
+  };
+
+  /**
+   * One completed second, for the fit, rejection and binning stage.
+   */
+  struct Second
+  {
+    long itime;			// Time index,
+    long irow;			// and row in the window.
+    long time1hz;		// Second of the particle that completed it.
+    double nextit;		// Interarrival time of that particle.
+    std::vector<float> fitspec;	// Interarrival counts to fit.
+    ParticleBatch particles;
+    double bestfit[3];		// Fit coefficients, in and out.
+    bool warmStart;
+    FitStats fitStats;
+    RejectStats rejectStats;	// With -profile.
+  };
+
+  /**
+   * Rows of the window on their way to the netCDF file.  Points into the
+   * window for the final write, or at a copy of the rows for a block
+   * streamed out while the window moves on.
+   */
+  struct Block
+  {
+    long base;		// Time index of the first row,
+    int n;		// and number of rows.
+    const int *count_it;
+
+    struct Rows
+    {
+      const float *count_all, *count_round, *conc_all, *conc_round;
+      ProbeData *data;
+    };
+    std::vector<Rows> sets;	// One per SizingSet.
+
+    std::vector<float> rows;	// Storage, for a copy.
+    std::vector<int> itRows;
+    std::deque<ProbeData> data;
+  };
+
+  /**
+   * Parallel decode of a chunk of records.
+   */
+  struct Chunk
+  {
+    std::vector<const P2d_rec *> records;
+    DecodeState boundary;	// State the decode started from.
+    DecodeState end;		// State after the last record.
+    std::vector<DecodedParticle> particles;
+    int nRecords;		// Records decoded before hitting the end time.
+    bool exact;			// Started from the exact state, no stitch needed.
+
+    Chunk(int nRows, int nDiodes) : boundary(nRows, nDiodes), end(nRows, nDiodes),
+	nRecords(0), exact(false) { }
+  };
+
+  // Worker thread main loop.
+  void run();
+
+  /**
+   * Decode records starting from state.
+   * @returns number of records processed before the end time.
+   */
+  int decode(DecodeState & state, const P2d_rec * const recs[], int nRecs,
+		std::vector<DecodedParticle> & out, unsigned char *image_buff) const
+  { return (this->*_decode)(state, recs, nRecs, out, image_buff); }
+
+  /**
+   * decode() for one probe family (slice size, byte order, sync and time
+   * word layout; see ProbeProcessor.cpp), so the slice loop is compiled
+   * per family with no probe type tests in it.  Picked once per probe by
+   * selectDecoder().
+   */
+  template <class Family>
+  int decodeFamily(DecodeState & state, const P2d_rec * const recs[], int nRecs,
+		std::vector<DecodedParticle> & out, unsigned char *image_buff) const;
+
+  typedef int (ProbeProcessor::*DecodeFunc)(DecodeState &, const P2d_rec * const [], int,
+		std::vector<DecodedParticle> &, unsigned char *) const;
+
+  static DecodeFunc selectDecoder(const ProbeInfo & probe);
+
+  // Accumulation stage; interarrival queue, per second processing.
+  void accumulate(const std::vector<DecodedParticle> & particles);
+
+  // Add (n = 1) or remove (n = -1) an interarrival time from _itHist.
+  void addInterarrival(double inttime, int n);
+
+  // Process the particle stack for the second that just completed.
+  void processSecond(const DecodedParticle & dp);
+
+  // Interarrival fit, rejection and binning of one second into each set.
+  void fitAndBin(Second & sec);
+
+  // In order completion of a second; fit stats, console and particle output.
+  // The Second is kept for reuse.
+  void retire(const std::shared_ptr<Second> & sec);
+
+  // Wait for the oldest second out at the thread pool and retire it.
+  void retireSecond();
+
+  // Retire all seconds out at the thread pool.
+  void drainSeconds();
+
+  // Bin a second's particles into a set, per their reject flags.
+  void binSecond(SizingSet & set, long irow, size_t n, const float size[],
+		const float wc[], const uint8_t flags[]);
+
+  // Blankouts, concentrations and derived parameters for rows first..first+n-1.
+  void computeDerived(SizingSet & set, int first, int n);
+
+  // computeDerived() for all sets, in blocks of rows on the thread pool.
+  void computeDerivedRows(int first, int n);
+
+  // Streaming; finish and write out the oldest half of the window, slide down.
+  void flushBlock();
+
+  // Rows of the window still to be written.
+  int rowsLeft() const { return std::min((long)_window, _numtimes - _base); }
+
+  // Queue the buffered particles for the writer, for -particles.
+  void flushParticles();
+
+  // Accumulate the particles in cache, in blocks.
+  void replayCache(FeatureCache & cache);
+
+  // Create the netCDF file and define our variables, once.
+  int defineVariables();
+
+  // The first n rows of the window, copied if they won't stay put.
+  std::shared_ptr<Block> makeBlock(int n, bool copy) const;
+
+  // Write a block.  Caller holds NetCDF::lock().
+  int writeBlock(const Block & block);
+
+  // Histogram variable name, e.g. A2DCA -> A2DCA_LPO with the probe id letter.
+  std::string varName(const char *base, const SizingSet & set) const;
+
+  // Hand a chunk to the thread pool.
+  void dispatchChunk(std::vector<const P2d_rec *> & records);
+
+  // Wait for the oldest chunk, stitch it on and accumulate it.
+  void collectChunk();
+
+  Config & _cfg;
+  NetCDF & _ncfile;
+  ProbeInfo & _probe;
+  ThreadPool *_pool;
+  ParticleFile *_particleFile;
+  ParticleFile::Columns _particleColumns;
+  std::unique_ptr<FeatureCache> _cache;	// Being written, for -cache.
+  std::unique_ptr<Profile> _profile;	// Stage timers, for -profile.
+
+  char _probetype;
+  char _probenumber;
+  bool _hasTASX;
+  std::vector<float> _tasx;	// TASX for the whole time range, read up front.
+
+  int _bytesPerSlice;
+  int _slicesPerRecord;
+  DecodeFunc _decode;
+  unsigned char *_image_buff;
+
+  int _numtimes;
+  int _buffcount;
+  std::atomic<bool> _done;
+
+  long _base;		// Time index of the first row of the window.
+  int _window;		// Rows in the count and data arrays.
+  long _lateSeconds;	// Seconds dropped for arriving after being written.
+  bool _defined;	// netCDF variables have been defined.
+
+  DecodeState _state;
+
+  // Record queue feeding the worker thread.
+  static const size_t maxQueue = 256;
+  std::thread _worker;
+  std::mutex _mutex;
+  std::condition_variable _queueNotEmpty, _queueNotFull;
+  std::deque<const P2d_rec *> _queue;
+  bool _endOfData;
+  bool _finished;	// Set by the writer thread.
+
+  // Chunks out at the thread pool, oldest first.
+  static const size_t chunkRecords = 128;	// Minimum records per chunk.
+  static const size_t warmupRecords = 4;	// Warmup records before the last second,
+  static const size_t maxWarmupRecords = 32;	// and the most to warm up on.
+  std::deque<std::shared_ptr<Chunk> > _chunks;
+  std::deque<std::future<void> > _pending;
+  std::vector<const P2d_rec *> _warmup;		// Tail of the last chunk dispatched.
+
+  // Seconds out at the thread pool for fitting and binning, oldest first.
+  static const size_t maxSeconds = 64;
+  std::deque<std::shared_ptr<Second> > _seconds;
+  std::deque<std::future<void> > _secondsPending;
+  std::vector<std::shared_ptr<Second> > _spareSeconds;	// Retired, to reuse.
+
+  ParticleBatch _particle_stack;
+
+  std::vector<std::unique_ptr<SizingSet> > _sets;
+  std::vector<int *> _count_it;
+
+  // Shattering correction and interarrival setup
+  static const int nitq = 400;	// number of interarrival times to keep for fitting
+  int _iitq;			// current index of itq
+  double _bestfit[3];
+  double _itq[nitq];
+
+  std::vector<float> _it_endpoints, _it_midpoints;
+  BinLookup _itBins;
+  std::vector<int> _itHist;	// _itq binned by _it_endpoints.
+  FitStats _fitStats;
+};
+
+#endif
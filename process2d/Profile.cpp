@@ -0,0 +1,69 @@
+#include "Profile.h"
+
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+const char *Profile::stageName(Stage stage)
+{
+  static const char *names[] = { "read", "decode", "rle", "size", "fillholes",
+	"fit", "bin", "derived", "write" };
+  return names[stage];
+}
+
+/* -------------------------------------------------------------------- */
+Profile::Profile() : _start(now())
+{
+  for (int i = 0; i < nStages; ++i)
+  {
+    _ns[i] = 0;
+    _calls[i] = 0;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+void Profile::Report(ostream & out, const string & name, long records, long bytes,
+		const FitStats *fitStats) const
+{
+  auto rate = [](double n, double s) { return s > 0 ? n / s : 0.0; };
+  double wall = (now() - _start) * 1.0e-9;
+  ios_base::fmtflags flags = out.flags();
+  streamsize precision = out.precision();
+
+  out << fixed;
+  for (int i = 0; i < nStages; ++i)
+  {
+    if (_calls[i] == 0)
+      continue;
+
+    double s = _ns[i] * 1.0e-9;
+    out	<< "profile probe=" << name << " stage=" << stageName((Stage)i)
+	<< setprecision(6) << " seconds=" << s << " calls=" << _calls[i]
+	<< setprecision(1) << " records_per_s=" << rate(records, s)
+	<< " particles_per_s=" << rate(particles, s)
+	<< " MB_per_s=" << rate(bytes * 1.0e-6, s) << "\n";
+  }
+
+  out	<< "profile probe=" << name << " counters"
+	<< setprecision(6) << " wall_seconds=" << wall
+	<< " records=" << records << " bytes=" << bytes;
+  if (fitStats)
+    out	<< " sync_words=" << syncWords << " particles=" << particles
+	<< " ireject=" << rejects.ireject << " wreject=" << rejects.wreject
+	<< " reject_dof=" << rejects.dof
+	<< " reject_interarrival=" << rejects.interarrival
+	<< " reject_area_ratio=" << rejects.areaRatio
+	<< " reject_acceptance=" << rejects.acceptance
+	<< " reject_size_range=" << rejects.sizeRange
+	<< " reject_water=" << rejects.water
+	<< " fits=" << fitStats->fits << " fit_iterations=" << fitStats->iterations
+	<< " fit_max_iterations=" << fitStats->maxIterations
+	<< " fit_unconverged=" << fitStats->unconverged
+	<< " fit_low_counts=" << fitStats->lowCounts;
+  out << endl;
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,81 @@
+#ifndef _profile_h_
+#define _profile_h_
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <cstdint>
+
+#include "particle.h"
+
+
+/**
+ * Stage timers and counters for one probe (or the file read), for -profile.
+ *
+ * Stages are timed with a Timer around the code, which does nothing but a
+ * null test when there is no Profile, so the timers can stay in the
+ * processing code.  Stages run on the worker and pool threads at once, so
+ * the times add up atomically and are the sum over threads, not wall
+ * clock; decode includes rle, size and fillholes, and the decode of warmup
+ * and stitched chunk records.  Counters are only touched in order, by the
+ * accumulation stage.
+ */
+class Profile
+{
+public:
+  enum Stage { READ, DECODE, RLE, SIZE, FILLHOLES, FIT, BIN, DERIVED, WRITE, nStages };
+
+  static const char *stageName(Stage stage);
+
+  static int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /**
+   * Time the enclosing scope into a stage, if there is a Profile.
+   */
+  class Timer
+  {
+  public:
+    Timer(Profile *profile, Stage stage)
+      : _profile(profile), _stage(stage), _start(profile ? now() : 0) { }
+    ~Timer() { if (_profile) _profile->Add(_stage, now() - _start); }
+
+  private:
+    Profile *_profile;
+    Stage _stage;
+    int64_t _start;
+  };
+
+  Profile();
+
+  void Add(Stage stage, int64_t ns)
+  {
+    _ns[stage].fetch_add(ns, std::memory_order_relaxed);
+    _calls[stage].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Print the report, one line per stage that ran and a line of counters,
+   * as "profile probe=<name> ..." followed by key=value pairs.  Rates are
+   * per second of stage time.
+   * @param fitStats interarrival fit counts; none for the file read, which
+   * has no particle counters either.
+   */
+  void Report(std::ostream & out, const std::string & name, long records, long bytes,
+		const FitStats *fitStats = 0) const;
+
+  long syncWords = 0;	// DecodedParticles, one per sync word,
+  long particles = 0;	// and those that were sized.
+  RejectStats rejects;	// First sizing method only.
+
+private:
+  std::atomic<int64_t> _ns[nStages];
+  std::atomic<long> _calls[nStages];
+  int64_t _start;	// Created, for the wall clock time.
+};
+
+#endif
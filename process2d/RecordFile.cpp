@@ -0,0 +1,88 @@
+#include "RecordFile.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/* -------------------------------------------------------------------- */
+RecordFile::RecordFile(const std::string & fileName)
+  : _data(0), _size(0), _pos(0), _mtime(0), _hash(0), _hashed(false)
+{
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    _mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED)
+    {
+      // One pass, front to back; let the kernel read ahead and drop behind.
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      _data = (const unsigned char *)p;
+      _size = st.st_size;
+    }
+  }
+
+  close(fd);
+}
+
+/* -------------------------------------------------------------------- */
+RecordFile::~RecordFile()
+{
+  if (_data)
+    munmap((void *)_data, _size);
+}
+
+/* -------------------------------------------------------------------- */
+static inline uint64_t rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static const uint64_t P1 = 0x9E3779B185EBCA87ULL, P2 = 0xC2B2AE3D27D4EB4FULL;
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t word)
+{
+  return rotl(acc + word * P2, 31) * P1;
+}
+
+/* -------------------------------------------------------------------- */
+uint64_t RecordFile::Hash() const
+{
+  if (_hashed)
+    return _hash;
+
+  // Four independent lanes of 64 bit multiply-rotate rounds, so the hash
+  // runs near memory speed; combined and mixed down at the end.
+  uint64_t lane[4] = { P1 + P2, P2, 0, (uint64_t)0 - P1 };
+  size_t i = 0;
+
+  for (; i + 32 <= _size; i += 32)
+    for (int j = 0; j < 4; ++j)
+    {
+      uint64_t word;
+      memcpy(&word, _data + i + 8 * j, 8);
+      lane[j] = hashRound(lane[j], word);
+    }
+
+  uint64_t h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+  h ^= _size;
+
+  for (; i < _size; ++i)
+    h = rotl(h ^ (_data[i] * P1), 11) * P2;
+
+  h ^= h >> 33; h *= P2;
+  h ^= h >> 29; h *= P1;
+  h ^= h >> 32;
+
+  _hash = h;
+  _hashed = true;
+  return h;
+}
@@ -0,0 +1,80 @@
+#ifndef _recordfile_h_
+#define _recordfile_h_
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#include "record.h"
+
+
+/**
+ * 2D file mapped into memory, for reading records without copying them.
+ * Next() hands out pointers straight into the mapping, which stay valid
+ * for the life of the RecordFile.
+ */
+class RecordFile
+{
+public:
+  RecordFile(const std::string & fileName);
+  ~RecordFile();
+
+  bool isOpen() const { return _data != 0; }
+
+  size_t size() const { return _size; }
+
+  /**
+   * Last modification time, ns since the epoch.
+   */
+  int64_t mtime() const { return _mtime; }
+
+  /**
+   * 64 bit hash of the whole file, to tell whether anything derived from
+   * it (e.g. a FeatureCache) is still current.  Not cryptographic.  Reads
+   * the whole file the first time, the result is kept for later calls.
+   */
+  uint64_t Hash() const;
+
+  /**
+   * Position at a file offset, normally the start of a record.
+   */
+  void Seek(size_t offset) { _pos = offset; }
+
+  /**
+   * File offset of the next record.
+   */
+  size_t tell() const { return _pos; }
+
+  /**
+   * @returns the record at a file offset, or 0 if there isn't a full one there.
+   */
+  const P2d_rec *At(size_t offset) const
+  {
+    if (offset + sizeof(P2d_rec) > _size)
+      return 0;
+    return (const P2d_rec *)(_data + offset);
+  }
+
+  /**
+   * @returns the next record, or 0 if there isn't a full record left.
+   */
+  const P2d_rec *Next()
+  {
+    if (_pos + sizeof(P2d_rec) > _size)
+      return 0;
+
+    const P2d_rec *rec = (const P2d_rec *)(_data + _pos);
+    _pos += sizeof(P2d_rec);
+    return rec;
+  }
+
+private:
+  const unsigned char *_data;
+  size_t _size;
+  size_t _pos;
+  int64_t _mtime;
+  mutable uint64_t _hash;
+  mutable bool _hashed;
+};
+
+#endif
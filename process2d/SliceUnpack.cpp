@@ -0,0 +1,212 @@
+#include "SliceUnpack.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SLICEUNPACK_X86
+#endif
+
+
+/* -------------------------------------------------------------------- */
+// Image buffers in a mapped file need not be aligned.
+static inline uint64_t load64(const unsigned char *p)
+{
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static inline uint32_t load32(const unsigned char *p)
+{
+  uint32_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+/* -------------------------------------------------------------------- */
+// Reverse the bit order within each byte.
+static inline uint64_t reverseByteBits(uint64_t x)
+{
+  x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+  x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+  return x;
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Slices first..n-1, a word at a time.
+ */
+static void unpackScalar(const unsigned char *slices, int first, int n, int sliceBytes,
+		bool lastByteFirst, uint64_t *rows)
+{
+  switch (sliceBytes)
+  {
+    case 4:
+      for (int i = first; i < n; ++i)
+      {
+        uint32_t w = load32(&slices[i*4]);
+        if (lastByteFirst) w = __builtin_bswap32(w);
+        rows[i] = (uint32_t)~reverseByteBits(w);
+      }
+      break;
+
+    case 8:
+      for (int i = first; i < n; ++i)
+      {
+        uint64_t w = load64(&slices[i*8]);
+        if (lastByteFirst) w = __builtin_bswap64(w);
+        rows[i] = ~reverseByteBits(w);
+      }
+      break;
+
+    case 16:
+      for (int i = first; i < n; ++i)
+      {
+        uint64_t w0 = load64(&slices[i*16]), w1 = load64(&slices[i*16+8]);
+        if (lastByteFirst)
+        {
+          uint64_t t = __builtin_bswap64(w0);
+          w0 = __builtin_bswap64(w1);
+          w1 = t;
+        }
+        rows[i*2] = ~reverseByteBits(w0);
+        rows[i*2+1] = ~reverseByteBits(w1);
+      }
+      break;
+
+    default:
+    {
+      int nWords = (sliceBytes + 7) / 8;
+      for (int i = first; i < n; ++i)
+      {
+        const unsigned char *slice = &slices[i*sliceBytes];
+        uint64_t *row = &rows[i*nWords];
+        for (int w = 0; w < nWords; ++w)
+          row[w] = 0;
+        for (int b = 0; b < sliceBytes; ++b)
+        {
+          unsigned char c = lastByteFirst ? slice[sliceBytes-1-b] : slice[b];
+          row[b >> 3] |= (uint64_t)(unsigned char)~reverseByteBits(c) << ((b & 7) * 8);
+        }
+      }
+    }
+  }
+}
+
+#ifdef SLICEUNPACK_X86
+/* -------------------------------------------------------------------- */
+/* Bit reversal of each byte by nibble lookups, then invert (shadowed = 1),
+ * then byte order reversal within each slice by a shuffle.
+ */
+static const char revLowNibble[16] =	// Reversed, into the high nibble.
+  { 0x00, (char)0x80, 0x40, (char)0xC0, 0x20, (char)0xA0, 0x60, (char)0xE0,
+    0x10, (char)0x90, 0x50, (char)0xD0, 0x30, (char)0xB0, 0x70, (char)0xF0 };
+static const char revHighNibble[16] =	// Reversed, into the low nibble.
+  { 0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF };
+
+// Shuffle reversing the bytes within each group of sliceBytes.
+static inline void reverseOrder(char order[16], int sliceBytes)
+{
+  for (int j = 0; j < 16; ++j)
+    order[j] = (j / sliceBytes) * sliceBytes + (sliceBytes - 1 - j % sliceBytes);
+}
+
+/* -------------------------------------------------------------------- */
+__attribute__((target("ssse3")))
+static inline __m128i unpack16(__m128i v, __m128i lo, __m128i hi, __m128i order, bool lastByteFirst)
+{
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  __m128i r = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, nibble)),
+		_mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(v, 4), nibble)));
+  r = _mm_xor_si128(r, _mm_set1_epi8(-1));
+  return lastByteFirst ? _mm_shuffle_epi8(r, order) : r;
+}
+
+__attribute__((target("ssse3")))
+static int unpackSSSE3(const unsigned char *slices, int n, int sliceBytes,
+		bool lastByteFirst, uint64_t *rows)
+{
+  char o[16];
+  reverseOrder(o, sliceBytes);
+  const __m128i lo = _mm_loadu_si128((const __m128i *)revLowNibble);
+  const __m128i hi = _mm_loadu_si128((const __m128i *)revHighNibble);
+  const __m128i order = _mm_loadu_si128((const __m128i *)o);
+  const int perBlock = 16 / sliceBytes;
+  int i = 0;
+
+  for (; i + perBlock <= n; i += perBlock)
+  {
+    __m128i r = unpack16(_mm_loadu_si128((const __m128i *)&slices[i*sliceBytes]),
+		lo, hi, order, lastByteFirst);
+
+    if (sliceBytes == 4)	// Zero extend into 64 bit rows.
+    {
+      _mm_storeu_si128((__m128i *)&rows[i], _mm_unpacklo_epi32(r, _mm_setzero_si128()));
+      _mm_storeu_si128((__m128i *)&rows[i+2], _mm_unpackhi_epi32(r, _mm_setzero_si128()));
+    }
+    else
+      _mm_storeu_si128((__m128i *)&rows[i*sliceBytes/8], r);
+  }
+  return i;
+}
+
+/* -------------------------------------------------------------------- */
+__attribute__((target("avx2")))
+static int unpackAVX2(const unsigned char *slices, int n, int sliceBytes,
+		bool lastByteFirst, uint64_t *rows)
+{
+  char o[16];
+  reverseOrder(o, sliceBytes);
+  const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)revLowNibble));
+  const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)revHighNibble));
+  const __m256i order = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)o));
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  const int perBlock = 32 / sliceBytes;
+  int i = 0;
+
+  for (; i + perBlock <= n; i += perBlock)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)&slices[i*sliceBytes]);
+    __m256i r = _mm256_or_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(v, nibble)),
+		_mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+    r = _mm256_xor_si256(r, _mm256_set1_epi8(-1));
+    if (lastByteFirst)
+      r = _mm256_shuffle_epi8(r, order);
+
+    if (sliceBytes == 4)	// Zero extend into 64 bit rows.
+    {
+      _mm256_storeu_si256((__m256i *)&rows[i], _mm256_cvtepu32_epi64(_mm256_castsi256_si128(r)));
+      _mm256_storeu_si256((__m256i *)&rows[i+4], _mm256_cvtepu32_epi64(_mm256_extracti128_si256(r, 1)));
+    }
+    else
+      _mm256_storeu_si256((__m256i *)&rows[i*sliceBytes/8], r);
+  }
+  return i;
+}
+
+// Static initializers may run before the compiler's own CPU detection.
+static const bool haveAVX2 = []{ __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }();
+static const bool haveSSSE3 = []{ __builtin_cpu_init(); return __builtin_cpu_supports("ssse3"); }();
+#endif
+
+/* -------------------------------------------------------------------- */
+void unpackSlices(const unsigned char *slices, int n, int sliceBytes,
+		bool lastByteFirst, uint64_t *rows)
+{
+  int done = 0;
+
+#ifdef SLICEUNPACK_X86
+  if (sliceBytes == 4 || sliceBytes == 8 || sliceBytes == 16)
+  {
+    if (haveAVX2)
+      done = unpackAVX2(slices, n, sliceBytes, lastByteFirst, rows);
+    else
+    if (haveSSSE3)
+      done = unpackSSSE3(slices, n, sliceBytes, lastByteFirst, rows);
+  }
+#endif
+
+  unpackScalar(slices, done, n, sliceBytes, lastByteFirst, rows);
+}
@@ -0,0 +1,23 @@
+#ifndef _sliceunpack_h_
+#define _sliceunpack_h_
+
+#include <cstdint>
+
+
+/**
+ * Unpack n consecutive image slices of sliceBytes each into ParticleImage
+ * rows (diode j at bit j, 1 = shadowed), (sliceBytes + 7) / 8 words per
+ * row, rows contiguous from rows.
+ *
+ * The probes record a shadowed diode as 0, and the first diode in the high
+ * bit of its byte.  SPEC and CIP/PIP slices start with the last byte
+ * (lastByteFirst), Fast2D with the first.
+ *
+ * 4, 8 and 16 byte slices (32, 64 and 128 diodes) are done 16 or 32 bytes
+ * at a time with SSSE3 or AVX2 shuffles where available, otherwise a word
+ * at a time; any other size a byte at a time.  Assumes a little-endian host.
+ */
+void unpackSlices(const unsigned char *slices, int n, int sliceBytes,
+		bool lastByteFirst, uint64_t *rows);
+
+#endif
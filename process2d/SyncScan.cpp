@@ -0,0 +1,105 @@
+#include "SyncScan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYNCSCAN_X86
+#endif
+
+static const unsigned char syncByte = 0xAA;
+
+
+/* -------------------------------------------------------------------- */
+/**
+ * Slices first..last-1, one at a time.
+ */
+static void scanScalar(const unsigned char *image, int first, int last, int sliceBytes,
+		uint32_t syncBytes, std::vector<int> & out)
+{
+  for (int i = first; i < last; ++i)
+  {
+    const unsigned char *slice = &image[i * sliceBytes];
+    bool sync = true;
+    for (int b = 0; b < sliceBytes && sync; ++b)
+      if ((syncBytes & (1u << b)) && slice[b] != syncByte)
+        sync = false;
+    if (sync)
+      out.push_back(i);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/**
+ * Sync slices in one block of bytes matching syncByte, given as a mask
+ * with a bit per byte (from movemask).  The block starts at slice first.
+ */
+static inline void blockSyncs(uint32_t match, int blockBytes, int first, int sliceBytes,
+		uint32_t syncBytes, std::vector<int> & out)
+{
+  if (match == 0)	// Nearly every block, image data is rarely 0xAA.
+    return;
+
+  for (int k = 0, shift = 0; shift < blockBytes; ++k, shift += sliceBytes)
+    if (((match >> shift) & syncBytes) == syncBytes)
+      out.push_back(first + k);
+}
+
+#ifdef SYNCSCAN_X86
+/* -------------------------------------------------------------------- */
+__attribute__((target("sse2")))
+static int scanSSE2(const unsigned char *image, int nSlices, int sliceBytes,
+		uint32_t syncBytes, std::vector<int> & out)
+{
+  const int perBlock = 16 / sliceBytes;
+  const __m128i sync = _mm_set1_epi8((char)syncByte);
+  int i = 0;
+
+  for (; i + perBlock <= nSlices; i += perBlock)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)&image[i * sliceBytes]);
+    uint32_t match = _mm_movemask_epi8(_mm_cmpeq_epi8(v, sync));
+    blockSyncs(match, 16, i, sliceBytes, syncBytes, out);
+  }
+  return i;
+}
+
+/* -------------------------------------------------------------------- */
+__attribute__((target("avx2")))
+static int scanAVX2(const unsigned char *image, int nSlices, int sliceBytes,
+		uint32_t syncBytes, std::vector<int> & out)
+{
+  const int perBlock = 32 / sliceBytes;
+  const __m256i sync = _mm256_set1_epi8((char)syncByte);
+  int i = 0;
+
+  for (; i + perBlock <= nSlices; i += perBlock)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)&image[i * sliceBytes]);
+    uint32_t match = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, sync));
+    blockSyncs(match, 32, i, sliceBytes, syncBytes, out);
+  }
+  return i;
+}
+
+// Static initializers may run before the compiler's own CPU detection.
+static const bool haveAVX2 = []{ __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }();
+static const bool haveSSE2 = []{ __builtin_cpu_init(); return __builtin_cpu_supports("sse2"); }();
+#endif
+
+/* -------------------------------------------------------------------- */
+void findSyncSlices(const unsigned char *image, int nSlices, int sliceBytes,
+		uint32_t syncBytes, std::vector<int> & out)
+{
+  int done = 0;
+
+  out.clear();
+
+#ifdef SYNCSCAN_X86
+  if (haveAVX2)
+    done = scanAVX2(image, nSlices, sliceBytes, syncBytes, out);
+  else
+  if (haveSSE2)
+    done = scanSSE2(image, nSlices, sliceBytes, syncBytes, out);
+#endif
+
+  scanScalar(image, done, nSlices, sliceBytes, syncBytes, out);
+}
@@ -0,0 +1,22 @@
+#ifndef _syncscan_h_
+#define _syncscan_h_
+
+#include <vector>
+#include <cstdint>
+
+
+/**
+ * Find the sync slices in a decoded image buffer in one pass, so the
+ * decoder can go from one particle to the next instead of testing each
+ * slice.  A slice of sliceBytes (4, 8 or 16) is a sync slice if each of
+ * its bytes picked by syncBytes (bit i for byte i of the slice) is 0xAA.
+ *
+ * Uses AVX2 or SSE2 compares where available, 16 or 32 bytes at a time,
+ * with a scalar fallback; the result is the same either way.
+ *
+ * @param out set to the indices of the sync slices, ascending.
+ */
+void findSyncSlices(const unsigned char *image, int nSlices, int sliceBytes,
+		uint32_t syncBytes, std::vector<int> & out);
+
+#endif
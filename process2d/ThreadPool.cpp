@@ -0,0 +1,42 @@
+#include "ThreadPool.h"
+
+
+/* -------------------------------------------------------------------- */
+ThreadPool::ThreadPool(size_t nThreads) : _stop(false)
+{
+  for (size_t i = 0; i < nThreads; ++i)
+    _threads.push_back(std::thread(&ThreadPool::run, this));
+}
+
+/* -------------------------------------------------------------------- */
+ThreadPool::~ThreadPool()
+{
+  {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stop = true;
+  }
+  _cond.notify_all();
+
+  for (size_t i = 0; i < _threads.size(); ++i)
+    _threads[i].join();
+}
+
+/* -------------------------------------------------------------------- */
+void ThreadPool::run()
+{
+  while (true)
+  {
+    std::function<void()> job;
+    {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond.wait(lock, [this]{ return _stop || !_jobs.empty(); });
+
+    if (_jobs.empty())
+      return;
+
+    job = std::move(_jobs.front());
+    _jobs.pop_front();
+    }
+    job();
+  }
+}
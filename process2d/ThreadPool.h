@@ -0,0 +1,53 @@
+#ifndef _threadpool_h_
+#define _threadpool_h_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+
+/**
+ * Fixed size pool of worker threads, shared by all probes for the work
+ * that can be split up within a probe.
+ */
+class ThreadPool
+{
+public:
+  ThreadPool(size_t nThreads);
+  ~ThreadPool();
+
+  size_t size() const { return _threads.size(); }
+
+  /**
+   * Queue a task, returns a future for its result.
+   */
+  template <typename F>
+  std::future<typename std::invoke_result<F>::type> Submit(F task)
+  {
+    typedef typename std::invoke_result<F>::type R;
+    auto job = std::make_shared<std::packaged_task<R()> >(std::move(task));
+    std::future<R> result = job->get_future();
+    {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.push_back([job]() { (*job)(); });
+    }
+    _cond.notify_one();
+    return result;
+  }
+
+private:
+  void run();
+
+  std::vector<std::thread> _threads;
+  std::deque<std::function<void()> > _jobs;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  bool _stop;
+};
+
+#endif
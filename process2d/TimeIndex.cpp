@@ -0,0 +1,165 @@
+#include "TimeIndex.h"
+#include "RecordFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+static uint64_t swap64(uint64_t x)
+{
+  if (5 == ntohl(5))		// Big-endian, nothing to do.
+    return x;
+
+  return ((uint64_t)ntohl(x & 0xffffffff) << 32) | ntohl(x >> 32);
+}
+
+/* -------------------------------------------------------------------- */
+static time_t modifyTime(const string & file)
+{
+  struct stat st;
+  if (stat(file.c_str(), &st) != 0)
+    return 0;
+  return st.st_mtime;
+}
+
+/* -------------------------------------------------------------------- */
+TimeIndex::TimeIndex(const string & dataFile) : _dataFile(dataFile)
+{
+  size_t pos = dataFile.rfind(".2d");
+  if (pos == string::npos)
+    _indexFile = dataFile + ".2Didx";
+  else
+    _indexFile = dataFile.substr(0, pos) + ".2Didx";
+}
+
+/* -------------------------------------------------------------------- */
+bool TimeIndex::Read()
+{
+  FILE *fp;
+
+  if (modifyTime(_indexFile) <= modifyTime(_dataFile) ||
+      (fp = fopen(_indexFile.c_str(), "rb")) == 0)
+    return false;
+
+  fseek(fp, 0, SEEK_END);
+  long len = ftell(fp);
+  rewind(fp);
+
+  _indices.resize(len / sizeof(Index));
+  if (_indices.size() == 0 ||
+      fread(&_indices[0], sizeof(Index), _indices.size(), fp) != _indices.size())
+    _indices.clear();
+  fclose(fp);
+
+  for (size_t i = 0; i < _indices.size(); ++i)
+    _indices[i].index = swap64(_indices[i].index);
+
+  return _indices.size() > 0;
+}
+
+/* -------------------------------------------------------------------- */
+int TimeIndex::Write()
+{
+  FILE *fp;
+
+  if ((fp = fopen(_indexFile.c_str(), "w+b")) == 0)
+    return 1;
+
+  vector<Index> out(_indices);
+  for (size_t i = 0; i < out.size(); ++i)
+    out[i].index = swap64(out[i].index);
+
+  size_t n = fwrite(&out[0], sizeof(Index), out.size(), fp);
+  fclose(fp);
+
+  return n == out.size() ? 0 : 1;
+}
+
+/* -------------------------------------------------------------------- */
+void TimeIndex::Add(const P2d_rec & rec, uint64_t offset)
+{
+  Index newOne;
+  newOne.index = offset;
+  memcpy(newOne.time, &rec.hour, 6);
+  newOne.time[3] = 0;
+  _indices.push_back(newOne);
+}
+
+/* -------------------------------------------------------------------- */
+int64_t TimeIndex::Range(time_t start, time_t stop, time_t day0, size_t nBefore,
+		const RecordFile & file, const vector<ProbeInfo> & probes, int64_t & stopPos) const
+{
+  struct Probe
+  {
+    uint64_t first;		// First record, in case there are none before start.
+    deque<uint64_t> before;	// Last nBefore records before start.
+    int64_t after;		// First record at or after stop.
+  };
+  map<string, Probe> seen;
+  long firstSfm = -1;
+
+  /* Records from different probes are not strictly in time order, so go
+   * through the whole list.  This is all in memory.
+   */
+  for (size_t i = 0; i < _indices.size(); ++i)
+  {
+    const P2d_rec *rec = file.At(_indices[i].index);
+    if (rec == 0)
+      break;
+
+    string id{ rec->probetype, rec->probenumber };
+    if (find_if(probes.begin(), probes.end(),
+		[&id](const ProbeInfo & p) { return p.id == id; }) == probes.end())
+      continue;
+
+    long sfm =	ntohs(_indices[i].time[0]) * 3600 +
+		ntohs(_indices[i].time[1]) * 60 +
+		ntohs(_indices[i].time[2]);
+
+    if (firstSfm < 0)
+      firstSfm = sfm;
+    if (sfm + 43200 < firstSfm)	// Midnight crossing
+      sfm += 86400;
+
+    auto it = seen.find(id);
+    if (it == seen.end())
+      it = seen.insert(make_pair(id, Probe{ _indices[i].index, deque<uint64_t>(), -1 })).first;
+    Probe & probe = it->second;
+
+    if (day0 + sfm < start)
+    {
+      if (probe.before.size() >= max(nBefore, (size_t)1))
+        probe.before.pop_front();
+      probe.before.push_back(_indices[i].index);
+    }
+    else
+    if (day0 + sfm >= stop && probe.after < 0)
+      probe.after = _indices[i].index;
+  }
+
+  if (seen.empty())
+    return -1;
+
+  int64_t startPos = -1;
+  stopPos = 0;
+  for (auto & p : seen)
+  {
+    int64_t from = p.second.before.empty() ? p.second.first : p.second.before.front();
+    if (startPos < 0 || from < startPos)
+      startPos = from;
+    if (p.second.after < 0 || stopPos < 0)
+      stopPos = -1;
+    else
+      stopPos = max(stopPos, p.second.after + (int64_t)sizeof(P2d_rec));
+  }
+
+  return startPos;
+}
@@ -0,0 +1,69 @@
+#ifndef _timeindex_h_
+#define _timeindex_h_
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+
+#include "record.h"
+#include "probe.h"
+
+class RecordFile;
+
+
+/**
+ * File offset and time of each 2D record, persisted next to the 2D file so
+ * later runs can seek straight to a start time.  Same format as the xpms2d
+ * .2Didx file (big-endian offset, then hour, minute, second as found in the
+ * record), so either program can build it.
+ */
+class TimeIndex
+{
+public:
+  TimeIndex(const std::string & dataFile);
+
+  /**
+   * Read the index file, if there is one newer than the 2D file.
+   * @returns true if an index was loaded.
+   */
+  bool Read();
+
+  /**
+   * Write the index file.
+   * @returns 0 on success.
+   */
+  int Write();
+
+  void Add(const P2d_rec & rec, uint64_t offset);
+
+  size_t size() const { return _indices.size(); }
+
+  const std::string & fileName() const { return _indexFile; }
+
+  /**
+   * Where to read the 2D file from and to for start through stop time, so
+   * each probe sees the same records around them as when reading all of
+   * it: from the earliest of each probe's last nBefore records before
+   * start, to just past the latest of each probe's first record at or
+   * after stop.  A buffer can hold tens of seconds of sparse data, so no
+   * fixed margin does.  Times in the index are taken to start on the same
+   * day as the first record (day0 is that midnight); which probe a record
+   * is from is read from file at its offset.
+   * @param stopPos set to the offset to stop at, -1 if some probe has no
+   *	record that late.
+   * @returns offset to start at, -1 if there are no records of probes.
+   */
+  int64_t Range(time_t start, time_t stop, time_t day0, size_t nBefore, const RecordFile & file,
+		const std::vector<ProbeInfo> & probes, int64_t & stopPos) const;
+
+private:
+  struct Index { uint64_t index; int16_t time[4]; };
+
+  std::string _dataFile;
+  std::string _indexFile;
+
+  std::vector<Index> _indices;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Micro-benchmark for CIP/PIP run length decoding.  Times CIPDecoder
+ * against uncompressCIP(), what decode() used before (realigned with a
+ * memmove), on the CIP/PIP records of a 2D file, in MB/s of record image
+ * data, and checks they give the same slices.
+ *
+ * Usage: bench_cip file.2d [passes]
+ */
+#include "../CIPDecoder.h"
+#include "../record.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+// The way decode() used to do it.
+static int uncompressCIP(unsigned char *dest, const unsigned char src[], int nbytes,
+		unsigned char residualBytes[16], size_t & nResidualBytes)
+{
+  int d_idx = 0, i = 0;
+
+  if (nResidualBytes)
+  {
+    memcpy(dest, residualBytes, nResidualBytes);
+    d_idx = nResidualBytes;
+    nResidualBytes = 0;
+  }
+
+  for (; i < nbytes; ++i)
+  {
+    unsigned char b = src[i];
+
+    int nBytes = (b & 0x1F) + 1;
+
+    if ((b & 0x20))     // This is a dummy byte; for alignment purposes.
+    {
+      continue;
+    }
+
+    if ((b & 0xE0) == 0)
+    {
+      memcpy(&dest[d_idx], &src[i+1], nBytes);
+      d_idx += nBytes;
+      i += nBytes;
+    }
+
+    if ((b & 0x80))
+    {
+      memset(&dest[d_idx], 0, nBytes);
+      d_idx += nBytes;
+    }
+    else
+    if ((b & 0x40))
+    {
+      memset(&dest[d_idx], 0xFF, nBytes);
+      d_idx += nBytes;
+    }
+  }
+
+  // Align data.  Find a sync word and put record on mod 8.
+  for (i = 0; i < d_idx; ++i)
+  {
+     if (memcmp(&dest[i], syncString, 8) == 0)
+     {
+       int n = (&dest[i] - dest) % 8;
+       if (n > 0)
+       {
+         memmove(dest, &dest[n], d_idx);
+         d_idx -= n;
+       }
+       break;
+     }
+  }
+
+  if (d_idx % 8)
+  {
+    size_t idx = d_idx / 8 * 8;
+    nResidualBytes = d_idx % 8;
+    memcpy(residualBytes, &dest[idx], nResidualBytes);
+  }
+
+  return d_idx / 8;     // return number of slices.
+}
+
+/* -------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: bench_cip file.2d [passes]" << endl;
+    return 1;
+  }
+  int passes = argc > 2 ? atoi(argv[2]) : 20;
+
+  ifstream in(argv[1], ios::binary);
+  string file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  size_t pos = file.find("</OAP>");
+  if (pos == string::npos)
+  {
+    cerr << "No XML header in " << argv[1] << endl;
+    return 1;
+  }
+  pos = file.find('\n', pos) + 1;
+
+  map<string, vector<const P2d_rec *> > probes;
+  for (; pos + sizeof(P2d_rec) <= file.size(); pos += sizeof(P2d_rec))
+  {
+    const P2d_rec *rec = (const P2d_rec *)&file[pos];
+    if (rec->probenumber == '8')
+      probes[string(1, rec->probetype) + rec->probenumber].push_back(rec);
+  }
+
+  for (auto & p : probes)
+  {
+    const vector<const P2d_rec *> & recs = p.second;
+    vector<unsigned char> buffer(CIPDecoder::bufferSize, 0);
+    vector<unsigned char> oldOut, newOut;
+    long nSlices = 0;
+
+    auto t0 = chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass)
+    {
+      unsigned char residual[16];
+      size_t nResidual = 0;
+      for (const P2d_rec *rec : recs)
+      {
+        int n = uncompressCIP(buffer.data(), rec->image, sizeof(rec->image), residual, nResidual);
+        if (pass == 0)
+          oldOut.insert(oldOut.end(), buffer.begin(), buffer.begin() + n * 8);
+      }
+    }
+    auto t1 = chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass)
+    {
+      CIPDecoder decoder;
+      for (const P2d_rec *rec : recs)
+      {
+        const unsigned char *slices;
+        int n = decoder.Decode(rec->image, sizeof(rec->image), buffer.data(), slices);
+        if (pass == 0)
+        {
+          newOut.insert(newOut.end(), slices, slices + n * 8);
+          nSlices += n;
+        }
+      }
+    }
+    auto t2 = chrono::steady_clock::now();
+
+    double mb = (double)recs.size() * sizeof(recs[0]->image) * passes / 1.0e6;
+    double old_s = chrono::duration<double>(t1 - t0).count();
+    double new_s = chrono::duration<double>(t2 - t1).count();
+
+    cout	<< p.first << ": " << recs.size() << " records, " << nSlices << " slices" << endl
+	<< "  uncompressCIP : " << mb / old_s << " MB/s" << endl
+	<< "  CIPDecoder    : " << mb / new_s << " MB/s" << endl
+	<< "  speedup       : " << old_s / new_s << "x" << endl
+	<< "  identical     : " << (oldOut == newOut ? "yes" : "NO") << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Micro-benchmark for the particle minimum enclosing circle.  Times the
+ * 2D hull based minEnclosingCircle() against the general Miniball on every
+ * shadowed pixel (what findsize() used to do), on large HVPS size
+ * particles, and reports the largest difference in center and radius.
+ *
+ * Usage: bench_circle [nParticles]
+ */
+#include "../particle.h"
+#include "../Miniball.hpp"
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+static const int nDiodes = 128;	// HVPS
+static const int nSlices = 512;
+
+
+/* -------------------------------------------------------------------- */
+// Random, roughly elliptical blob with a ragged edge, >1000 pixels.
+static int makeParticle(ParticleImage & img, int & nslices, mt19937 & gen)
+{
+  uniform_real_distribution<double> U(0.0, 1.0);
+  double a = 15 + 40 * U(gen), b = 15 + 40 * U(gen), theta = M_PI * U(gen);
+  double xc = 20 + (nDiodes - 40) * U(gen);
+  nslices = (int)(2 * max(a, b)) + 4;
+  double yc = nslices / 2.0;
+  int area = 0;
+
+  for (int i = 0; i < nslices; i++)
+  {
+    uint64_t *row = img.row(i);
+    for (int w = 0; w < img.nWords(); w++) row[w] = 0;
+    for (int j = 0; j < nDiodes; j++)
+    {
+      double dx = j - xc, dy = i - yc;
+      double u = (dx * cos(theta) + dy * sin(theta)) / a;
+      double v = (-dx * sin(theta) + dy * cos(theta)) / b;
+      if (u*u + v*v < 1.0 - 0.1 * U(gen))
+      {
+        row[j >> 6] |= 1ULL << (j & 63);
+        ++area;
+      }
+    }
+  }
+  return area;
+}
+
+/* -------------------------------------------------------------------- */
+// The way findsize() used to do it.
+static void miniball(const ParticleImage & img, int nslices, double & xc, double & yc, double & r2)
+{
+  vector<short> x, y;
+  for (int i = 0; i < nslices; i++)
+    for (int j = 0; j < img.nDiodes(); j++)
+      if (img.shadowed(i, j)) { y.push_back(i); x.push_back(j); }
+
+  typedef double coordtype;
+  size_t npoints = x.size();
+  coordtype **coordpointer = new coordtype*[npoints];
+  for (size_t i = 0; i < npoints; i++) {
+    coordtype *p = new coordtype[2];
+    p[0] = x[i];
+    p[1] = y[i];
+    coordpointer[i] = p;
+  }
+
+  typedef coordtype* const* PointIterator;
+  typedef const coordtype* CoordIterator;
+  typedef Miniball::
+    Miniball <Miniball::CoordAccessor<PointIterator, CoordIterator> > MB;
+  MB ball(2, coordpointer, coordpointer+npoints);
+
+  xc = *ball.center();
+  yc = *(ball.center()+1);
+  r2 = ball.squared_radius();
+
+  for (size_t i = 0; i < npoints; ++i)
+    delete[] coordpointer[i];
+  delete[] coordpointer;
+}
+
+/* -------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+  int nParticles = argc > 1 ? atoi(argv[1]) : 2000;
+  mt19937 gen(2024);
+
+  vector<ParticleImage> images(nParticles, ParticleImage(nSlices, nDiodes));
+  vector<int> nslices(nParticles);
+  long totalArea = 0;
+  for (int p = 0; p < nParticles; p++)
+    totalArea += makeParticle(images[p], nslices[p], gen);
+
+  vector<double> mx(nParticles), my(nParticles), mr(nParticles);
+  auto t0 = chrono::steady_clock::now();
+  for (int p = 0; p < nParticles; p++)
+    miniball(images[p], nslices[p], mx[p], my[p], mr[p]);
+  auto t1 = chrono::steady_clock::now();
+
+  vector<double> cx(nParticles), cy(nParticles), cr(nParticles);
+  for (int p = 0; p < nParticles; p++)
+    minEnclosingCircle(images[p], nslices[p], cx[p], cy[p], cr[p]);
+  auto t2 = chrono::steady_clock::now();
+
+  double dcenter = 0, dradius = 0;
+  for (int p = 0; p < nParticles; p++)
+  {
+    dcenter = max(dcenter, max(fabs(cx[p] - mx[p]), fabs(cy[p] - my[p])));
+    dradius = max(dradius, fabs(sqrt(cr[p]) - sqrt(mr[p])));
+  }
+
+  double us_mb = chrono::duration<double, micro>(t1 - t0).count() / nParticles;
+  double us_mec = chrono::duration<double, micro>(t2 - t1).count() / nParticles;
+
+  cout	<< nParticles << " particles, mean area " << totalArea / nParticles << " pixels" << endl
+	<< "  Miniball, all pixels  : " << us_mb << " us/particle" << endl
+	<< "  minEnclosingCircle    : " << us_mec << " us/particle" << endl
+	<< "  speedup               : " << us_mb / us_mec << "x" << endl
+	<< "  max center difference : " << dcenter << " pixels" << endl
+	<< "  max radius difference : " << dradius << " pixels" << endl;
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Synthetic OAP file generator, for benchmarking process2d on data with a
+ * known size spectrum, particle rate, shattering and hole fraction.  Writes
+ * an XML header process2d can parse and 4116 byte records for each probe,
+ * merged in time order, as recorded.  Same options and seed give the same
+ * file (with the same C++ library).
+ *
+ * Usage: bench_gen2d [options] file.2d
+ *   -probes C4,C8,SH,H1	Probes, of C4 C6 (Fast2D), C8 (CIP), SH SV (2DS), H1 (HVPS).
+ *   -seconds 60		Length of the file.
+ *   -rate 200		Particles per second per probe, before shattering.
+ *   -size 0		Mean diameter in pixels; 0 is 6 for 64 diodes, 10 for 128.
+ *   -shape 1		Gamma shape of the size spectrum; 1 is exponential.
+ *   -shatter 0.05		Fraction of particles that shatter.
+ *   -holes 0.15		Fraction of particles over 6 pixels with a hole.
+ *   -dof 0.1		Fraction flagged out of the depth of field.
+ *   -tas 120		True airspeed, m/s.
+ *   -seed 1
+ */
+#include "synth.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+  SynthParams params;
+  string probeList = "C4,C8,SH,H1", outFile;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    bool value = i < argc-1;
+    if (arg == "-probes" && value) probeList = argv[++i]; else
+    if (arg == "-seconds" && value) params.seconds = atof(argv[++i]); else
+    if (arg == "-rate" && value) params.rate = atof(argv[++i]); else
+    if (arg == "-size" && value) params.meanSize = atof(argv[++i]); else
+    if (arg == "-shape" && value) params.shape = atof(argv[++i]); else
+    if (arg == "-shatter" && value) params.shatter = atof(argv[++i]); else
+    if (arg == "-holes" && value) params.holes = atof(argv[++i]); else
+    if (arg == "-dof" && value) params.dof = atof(argv[++i]); else
+    if (arg == "-tas" && value) params.tas = atoi(argv[++i]); else
+    if (arg == "-seed" && value) params.seed = atoi(argv[++i]); else
+    if (arg[0] != '-') outFile = arg; else
+    {
+      cerr << "bench_gen2d: unknown option " << arg << endl;
+      return 1;
+    }
+  }
+
+  if (outFile.empty())
+  {
+    cerr << "Usage: bench_gen2d [-probes C4,C8,SH,H1] [-seconds 60] [-rate 200] [-size 0]" << endl
+	 << "	[-shape 1] [-shatter 0.05] [-holes 0.15] [-dof 0.1] [-tas 120] [-seed 1] file.2d" << endl;
+    return 1;
+  }
+
+  vector<const SynthProbe *> probes;
+  stringstream ids(probeList);
+  for (string id; getline(ids, id, ','); )
+  {
+    const SynthProbe *p = findSynthProbe(id);
+    if (p == 0)
+    {
+      cerr << "bench_gen2d: unknown probe " << id << endl;
+      return 1;
+    }
+    probes.push_back(p);
+  }
+
+  ofstream out(outFile.c_str(), ios::binary);
+  if (!out)
+  {
+    cerr << "bench_gen2d: unable to create " << outFile << endl;
+    return 1;
+  }
+  out << synthHeader(probes);
+
+  // A record in hand per probe, write out the earliest each time.
+  vector<RecordSynth *> synths;
+  vector<P2d_rec> recs(probes.size());
+  vector<double> times(probes.size());
+  vector<bool> have(probes.size());
+  for (size_t i = 0; i < probes.size(); i++)
+  {
+    synths.push_back(new RecordSynth(params, *probes[i], params.seed * 7919 + i));
+    have[i] = synths[i]->Next(recs[i], times[i]);
+  }
+
+  long nRecords = 0;
+  for (;;)
+  {
+    int first = -1;
+    for (size_t i = 0; i < probes.size(); i++)
+      if (have[i] && (first < 0 || times[i] < times[first]))
+        first = i;
+    if (first < 0)
+      break;
+
+    out.write((const char *)&recs[first], sizeof(P2d_rec));
+    have[first] = synths[first]->Next(recs[first], times[first]);
+    ++nRecords;
+  }
+
+  for (RecordSynth *s : synths)
+    delete s;
+
+  cout << outFile << ": " << nRecords << " records, " << probes.size() << " probes, "
+	<< params.seconds << " seconds." << endl;
+  return out.good() ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#!/bin/sh
+#
+# Golden output check, so an optimization can be shown not to change the
+# results.  "record" runs a known good process2d on reference inputs and
+# keeps its output and run time; "check" runs the process2d being tested
+# on the same inputs and compares every variable written against the
+# golden output with bench_ncdiff, using the tolerances in golden.tol,
+# and prints the run times side by side.  "test", for scons test, checks
+# against the golden output stored in bench/golden instead.
+#
+# Usage: bench/golden.sh record|check|test [dir]
+#
+# Inputs are every .2d file in dir/inputs.  If there are none, synthetic
+# ones from bench_gen2d go there (one per probe family, a mixed file and
+# a dense, shattered one), the same every time; flight files may be added
+# for record and check.  Record runs GOLDEN_PROCESS2D, e.g. a build of the
+# release being compared against, with no options, so any version of
+# process2d can record.  Check processes each input with the default
+# options, with -threads 1, and with -methods all, each against the same
+# golden output, so threading and the extra sizing sets must not change
+# anything either.  Where there is a golden particle file,
+# name.particles.nc (e.g. kept from the check output of a build known to
+# be good), -particles output is compared with it too.  Check and test
+# also make sure -index gives the same output as reading the whole file,
+# on data sparse enough that a buffer holds tens of seconds, in dir/index.
+#
+# bench/golden holds the output of the original process2d on the synthetic
+# inputs, gzipped, and inputs.cksum, the inputs they were recorded from;
+# test fails if bench_gen2d no longer makes the same ones.  To redo them:
+#   GOLDEN_PROCESS2D=/path/to/process2d bench/golden.sh record dir
+#   gzip -9c dir/golden/name.nc > bench/golden/name.nc.gz, for each input
+#   (cd dir/inputs && cksum *.2d) > bench/golden/inputs.cksum
+#
+# Programs are looked for next to this script, after scons bench, unless
+# PROCESS2D, BENCH_GEN2D or BENCH_NCDIFF say otherwise; GOLDEN_PROCESS2D
+# defaults to PROCESS2D.  Exit status is 1 if any case differs.
+
+# Absolute, as process2d is run from the input's directory.
+abspath() { case $1 in /*) echo "$1" ;; *) echo "$PWD/$1" ;; esac; }
+
+bench=$(abspath "$(dirname "$0")")
+process2d=$(abspath "${PROCESS2D:-$bench/../process2d}")
+golden_process2d=$(abspath "${GOLDEN_PROCESS2D:-$process2d}")
+gen2d=${BENCH_GEN2D:-$bench/bench_gen2d}
+ncdiff=${BENCH_NCDIFF:-$bench/bench_ncdiff}
+tol=$bench/golden.tol
+stored=$bench/golden
+
+mode=$1
+dir=$(abspath "${2:-golden.work}")
+case $mode in
+  record|check|test) ;;
+  *)
+  echo "Usage: $0 record|check|test [dir]" >&2
+  exit 2 ;;
+esac
+
+for p in "$process2d" "$golden_process2d" "$gen2d" "$ncdiff"; do
+  if [ ! -x "$p" ]; then
+    echo "golden.sh: no $p, run scons bench first" >&2
+    exit 2
+  fi
+done
+
+mkdir -p "$dir/inputs" "$dir/golden" "$dir/output" || exit 2
+
+if ! ls "$dir"/inputs/*.2d > /dev/null 2>&1; then
+  for spec in fast2d:C4 fast2d_v2:C6 cip:C8 2ds:SH hvps:H1 mixed:C4,C8,SH,H1; do
+    "$gen2d" -probes "${spec#*:}" -seconds 60 -rate 300 "$dir/inputs/${spec%%:*}.2d" > /dev/null || exit 2
+  done
+  "$gen2d" -probes C4,C8,SH -seconds 30 -rate 2000 -shatter 0.2 -holes 0.4 \
+	"$dir/inputs/dense.2d" > /dev/null || exit 2
+fi
+
+# The stored golden output is only good for the inputs it came from.
+if [ "$mode" = test ]; then
+  if [ ! -f "$stored/inputs.cksum" ]; then
+    echo "golden.sh: no golden output in $stored" >&2
+    exit 2
+  fi
+  names=$(awk '{ print $3 }' "$stored/inputs.cksum")
+  if ! (cd "$dir/inputs" && cksum $names) | cmp -s - "$stored/inputs.cksum"; then
+    echo "golden.sh: inputs in $dir/inputs are not the ones the golden output was recorded from" >&2
+    exit 2
+  fi
+  for name in $names; do
+    name=$(basename "$name" .2d)
+    if [ ! -f "$stored/$name.nc.gz" ] || ! gzip -dc "$stored/$name.nc.gz" > "$dir/golden/$name.nc"; then
+      echo "golden.sh: no golden output $stored/$name.nc.gz" >&2
+      exit 2
+    fi
+    rm -f "$dir/golden/$name.seconds"
+  done
+fi
+
+now() { date +%s.%N; }
+
+# run <process2d> <input> <output> [options];  sets seconds.  Without -o,
+# which adds to an existing file, from the input's directory so the new
+# file, named for the input, is made there, then moved to output.
+run()
+{
+  program=$1 from=$2 to=$3
+  shift 3
+  rm -f "$to.nc"
+  start=$(now)
+  (cd "$(dirname "$from")" && "$program" "$(basename "$from")" "$@") > "$to.log" 2>&1 || return 1
+  seconds=$(awk "BEGIN { printf \"%.3f\", $(now) - $start }")
+  mv "$(dirname "$from")/$(basename "$from" .2d).nc" "$to.nc"
+}
+
+nCases=0
+nFailed=0
+for input in "$dir"/inputs/*.2d; do
+  [ -f "$input" ] || continue
+  name=$(basename "$input" .2d)
+  golden=$dir/golden/$name
+
+  if [ "$mode" = record ]; then
+    if ! run "$golden_process2d" "$input" "$golden"; then
+      echo "golden.sh: process2d failed on $input, see $golden.log" >&2
+      exit 2
+    fi
+    echo "$seconds" > "$golden.seconds"
+    echo "golden input=$name recorded seconds=$seconds"
+    continue
+  fi
+
+  if [ ! -f "$golden.nc" ]; then
+    echo "golden.sh: no golden output for $input, run record first" >&2
+    exit 2
+  fi
+
+  for variant in default threads1 methods; do
+    output=$dir/output/$name.$variant
+    rm -f "$output.particles.nc"
+    set --
+    [ -f "$golden.particles.nc" ] && set -- -particles "$output.particles.nc"
+    case $variant in
+      default)	run "$process2d" "$input" "$output" "$@" ;;
+      threads1)	run "$process2d" "$input" "$output" -threads 1 "$@" ;;
+      methods)	run "$process2d" "$input" "$output" -methods all "$@" ;;
+    esac
+    status=$?
+    nCases=$((nCases + 1))
+
+    result=ok
+    if [ $status -ne 0 ]; then
+      result=failed seconds=0
+    else
+      # -methods all adds variables, compare those that are in the golden output.
+      if [ $variant = methods ]; then
+        "$ncdiff" -tol "$tol" "$golden.nc" "$output.nc" | grep -v ": only in $output.nc" > "$output.diff"
+      else
+        "$ncdiff" -tol "$tol" "$golden.nc" "$output.nc" > "$output.diff"
+      fi
+      grep -q '^  ' "$output.diff" && result=differ
+      if [ -f "$golden.particles.nc" ] && ! "$ncdiff" "$golden.particles.nc" "$output.particles.nc" >> "$output.diff"; then
+        result=differ
+      fi
+    fi
+
+    times="seconds=$seconds"
+    if [ -f "$golden.seconds" ]; then
+      golden_seconds=$(cat "$golden.seconds")
+      times="$times golden_seconds=$golden_seconds speedup=$(awk "BEGIN { printf \"%.2f\", ($seconds > 0 ? $golden_seconds / $seconds : 0) }")"
+    fi
+    echo "golden input=$name variant=$variant result=$result $times"
+    if [ $result != ok ]; then
+      nFailed=$((nFailed + 1))
+      grep '^  ' "$output.diff" | head -20
+    fi
+  done
+done
+
+# -index against the whole file, around start and stop times that fall
+# in the middle of a buffer.
+if [ "$mode" != record ]; then
+  sparse=$dir/index/sparse.2d
+  if [ ! -f "$sparse" ]; then
+    mkdir -p "$dir/index" || exit 2
+    "$gen2d" -probes H1,C4 -seconds 300 -rate 2 "$sparse" > /dev/null || exit 2
+    touch -t 200001010000 "$sparse"	# Older than the index built from it.
+  fi
+  rm -f "$dir/index/sparse.2Didx"
+
+  for range in 123230-123400 123230-123250; do
+    times="-starttime ${range%-*} -stoptime ${range#*-}"
+    output=$dir/index/sparse.$range
+    nCases=$((nCases + 1))
+    result=ok
+    if ! run "$process2d" "$sparse" "$output" $times ||
+       ! run "$process2d" "$sparse" "$output.index" $times -index ||
+       ! run "$process2d" "$sparse" "$output.index" $times -index ||
+       ! grep -q "Using time index" "$output.index.log"; then
+      result=failed
+    elif ! "$ncdiff" "$output.nc" "$output.index.nc" > "$output.diff"; then
+      result=differ
+    fi
+    echo "golden input=sparse variant=index$range result=$result"
+    if [ $result != ok ]; then
+      nFailed=$((nFailed + 1))
+      grep '^  ' "$output.diff" | head -20
+    fi
+  done
+fi
+
+[ "$mode" != record ] && echo "golden: $nCases cases, $nFailed differ"
+[ $nFailed -eq 0 ]
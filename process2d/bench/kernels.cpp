@@ -0,0 +1,210 @@
+/*
+ * Per-kernel benchmark on synthetic data: findsize() and fillholes2() on
+ * particles of each array width, CIPDecoder (which replaced uncompressCIP)
+ * on generated CIP records, and dpoisson_fit() on interarrival histograms
+ * of a known double Poisson process.  Prints one JSON object, so runs can
+ * be compared; run.sh merges it with the end-to-end numbers.
+ *
+ * findsize and fillholes2 times include copying each particle into the
+ * image first, a few rows.
+ *
+ * Usage: bench_kernels [-particles 20000] [-passes 5] [-size 0] [-shape 1]
+ *	[-holes 0.15] [-seed 1]
+ */
+#include "synth.h"
+#include "../CIPDecoder.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+static const int nBins = 40;	// Config::nInterarrivalBins
+
+
+/* -------------------------------------------------------------------- */
+// One JSON result line; the caller puts the commas in.
+static void result(const string & kernel, const string & probe, long calls, double units,
+		const char *unit, double seconds)
+{
+  cout	<< "    {\"kernel\": \"" << kernel << "\", \"probe\": \"" << probe << "\""
+	<< ", \"calls\": " << calls << fixed << setprecision(6) << ", \"seconds\": " << seconds
+	<< setprecision(1) << ", \"ns_per_call\": " << (calls ? seconds * 1.0e9 / calls : 0.0)
+	<< ", \"" << unit << "_per_s\": " << (seconds > 0 ? units / seconds : 0.0) << "}";
+  cout.unsetf(ios_base::floatfield);
+}
+
+/* -------------------------------------------------------------------- */
+// Particles one after another, rows of nWords, and where each starts.
+struct Particles
+{
+  vector<uint64_t> bits;
+  vector<size_t> start;
+  vector<int> nSlices;
+};
+
+static void makeParticles(const SynthParams & params, int nDiodes, int n, Particles & p)
+{
+  ParticleSynth synth(params, nDiodes, params.seed);
+  ParticleImage img(512, nDiodes);
+
+  for (int k = 0; k < n; ++k)
+  {
+    int h = synth.Next(img);
+    p.start.push_back(p.bits.size());
+    p.nSlices.push_back(h);
+    p.bits.insert(p.bits.end(), img.row(0), img.row(0) + h * img.nWords());
+  }
+}
+
+/* -------------------------------------------------------------------- */
+static double timeParticles(const Particles & p, ParticleImage & img, int passes, float res,
+		bool fill, double & checksum)
+{
+  auto t0 = chrono::steady_clock::now();
+  for (int pass = 0; pass < passes; ++pass)
+    for (size_t k = 0; k < p.start.size(); ++k)
+    {
+      int h = p.nSlices[k];
+      memcpy(img.row(0), &p.bits[p.start[k]], h * img.nWords() * sizeof(uint64_t));
+      if (fill)
+        checksum += fillholes2(img, h);
+      else
+        checksum += findsize(img, h, res, Config::CIRCLE).size;
+    }
+  return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+/* -------------------------------------------------------------------- */
+// Histogram of interarrival times, rate per second with a fraction of them
+// shattered, binned as ProbeProcessor does.
+static void makeHistogram(mt19937 & rng, double rate, double shatter, vector<float> & y)
+{
+  uniform_real_distribution<double> U(0.0, 1.0);
+  exponential_distribution<double> real(rate), shattered(1.0e5);
+
+  y.assign(nBins, 0);
+  for (int k = 0; k < rate; ++k)
+  {
+    double t = (U(rng) < shatter) ? shattered(rng) : real(rng);
+    int bin = (int)floor(5 * log10(t) + 35);
+    if (bin >= 0 && bin < nBins)
+      y[bin]++;
+  }
+}
+
+
+/* -------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+  SynthParams params;
+  int nParticles = 20000, passes = 5;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    bool value = i < argc-1;
+    if (arg == "-particles" && value) nParticles = atoi(argv[++i]); else
+    if (arg == "-passes" && value) passes = max(1, atoi(argv[++i])); else
+    if (arg == "-size" && value) params.meanSize = atof(argv[++i]); else
+    if (arg == "-shape" && value) params.shape = atof(argv[++i]); else
+    if (arg == "-holes" && value) params.holes = atof(argv[++i]); else
+    if (arg == "-seed" && value) params.seed = atoi(argv[++i]); else
+    {
+      cerr << "Usage: bench_kernels [-particles 20000] [-passes 5] [-size 0] [-shape 1]" << endl
+	   << "	[-holes 0.15] [-seed 1]" << endl;
+      return 1;
+    }
+  }
+
+  double checksum = 0;
+
+  cout	<< "{\n  \"benchmark\": \"kernels\", \"particles\": " << nParticles
+	<< ", \"passes\": " << passes << ", \"seed\": " << params.seed << ",\n  \"results\": [\n";
+
+  // Particle kernels, a 64 and a 128 diode array.
+  const char *arrays[] = { "C4", "SH" };
+  for (const char *id : arrays)
+  {
+    const SynthProbe & probe = *findSynthProbe(id);
+    Particles p;
+    makeParticles(params, probe.nDiodes, nParticles, p);
+    ParticleImage img(512, probe.nDiodes);
+    long calls = (long)nParticles * passes;
+
+    double s = timeParticles(p, img, passes, probe.resolution, false, checksum);
+    result("findsize", id, calls, calls, "particles", s);
+    cout << ",\n";
+    s = timeParticles(p, img, passes, probe.resolution, true, checksum);
+    result("fillholes2", id, calls, calls, "particles", s);
+    cout << ",\n";
+  }
+
+  // CIP run length decoding; about as many particles as above.
+  {
+    SynthParams cipParams = params;
+    cipParams.rate = 1000;
+    cipParams.seconds = max(1.0, nParticles / cipParams.rate);
+    RecordSynth synth(cipParams, *findSynthProbe("C8"), params.seed);
+    vector<P2d_rec> recs;
+    P2d_rec rec;
+    double t;
+    while (synth.Next(rec, t))
+      recs.push_back(rec);
+
+    vector<unsigned char> buffer(CIPDecoder::bufferSize);
+    auto t0 = chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass)
+    {
+      CIPDecoder decoder;
+      for (const P2d_rec & r : recs)
+      {
+        const unsigned char *slices;
+        checksum += decoder.Decode(r.image, sizeof(r.image), buffer.data(), slices);
+      }
+    }
+    double s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    long calls = (long)recs.size() * passes;
+    result("CIPDecoder", "C8", calls, calls * sizeof(rec.image) * 1.0e-6, "MB", s);
+    cout << ",\n";
+  }
+
+  // Interarrival fits, one per second of data at a few particle rates.
+  {
+    vector<float> x;
+    for (int i = 0; i < nBins; i++)
+      x.push_back(pow(10, ((float)i-34.5)/5.0));
+
+    mt19937 rng(params.seed);
+    vector<vector<float> > hists(1000);
+    for (size_t k = 0; k < hists.size(); ++k)
+      makeHistogram(rng, 50 * (1 + k % 40), 0.1, hists[k]);
+
+    FitStats stats;
+    auto t0 = chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass)
+      for (const vector<float> & y : hists)
+      {
+        double a[3] = { 0, 0, 0 };
+        dpoisson_fit(x, y, a, false, &stats);
+        checksum += a[1];
+      }
+    double s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    long calls = (long)hists.size() * passes;
+    result("dpoisson_fit", "", calls, calls, "fits", s);
+    cout << ",\n";
+    cout << "    {\"kernel\": \"dpoisson_fit_stats\", \"fits\": " << stats.fits
+	<< ", \"iterations\": " << stats.iterations << ", \"unconverged\": " << stats.unconverged
+	<< ", \"low_counts\": " << stats.lowCounts << "}\n";
+  }
+
+  // The checksum keeps the work from being optimized away.
+  cout << "  ],\n  \"checksum\": " << setprecision(10) << checksum << "\n}" << endl;
+  return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Compare two process2d output files, variable by variable, for the golden
+ * output check (golden.sh).  Every variable and dimension in either file
+ * must be in both, the same shape, and the values within tolerance;
+ * attributes are not compared, as some hold the processing date.
+ *
+ * Tolerances come from a file of "variable-glob relative absolute" lines,
+ * first match wins, # to end of line is a comment.  Values a and b match
+ * when |a - b| <= absolute + relative * |a|; NaNs match NaNs.  A variable
+ * no line matches must be identical.
+ *
+ * Usage: bench_ncdiff [-tol file] [-v] golden.nc new.nc
+ *   -v	List every variable, not just those that differ.
+ * Exit status is 0 when the files match.
+ */
+#include <ncFile.h>
+#include <ncDim.h>
+#include <ncVar.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <fnmatch.h>
+
+using namespace std;
+using namespace netCDF;
+
+
+struct Tolerance
+{
+  string glob;
+  double relative, absolute;
+};
+
+/* -------------------------------------------------------------------- */
+static bool readTolerances(const string & file, vector<Tolerance> & tols)
+{
+  ifstream in(file.c_str());
+  if (!in)
+  {
+    cerr << "bench_ncdiff: unable to open " << file << endl;
+    return false;
+  }
+
+  string line;
+  for (int n = 1; getline(in, line); ++n)
+  {
+    line = line.substr(0, line.find('#'));
+    istringstream fields(line);
+    Tolerance t;
+    if (!(fields >> t.glob))
+      continue;
+    if (!(fields >> t.relative >> t.absolute))
+    {
+      cerr << "bench_ncdiff: " << file << ":" << n << ": expected glob relative absolute" << endl;
+      return false;
+    }
+    tols.push_back(t);
+  }
+  return true;
+}
+
+/* -------------------------------------------------------------------- */
+static Tolerance findTolerance(const vector<Tolerance> & tols, const string & name)
+{
+  for (const Tolerance & t : tols)
+    if (fnmatch(t.glob.c_str(), name.c_str(), 0) == 0)
+      return t;
+  return Tolerance{ "", 0.0, 0.0 };
+}
+
+/* -------------------------------------------------------------------- */
+static string shape(const NcVar & var)
+{
+  string s = "(";
+  for (const NcDim & dim : var.getDims())
+    s += (s.size() > 1 ? "," : "") + dim.getName() + "=" + to_string(dim.getSize());
+  return s + ")";
+}
+
+/* -------------------------------------------------------------------- */
+static vector<double> values(const NcVar & var)
+{
+  size_t n = 1;
+  for (const NcDim & dim : var.getDims())
+    n *= dim.getSize();
+  vector<double> v(n);
+  if (n > 0)
+    var.getVar(v.data());
+  return v;
+}
+
+/* -------------------------------------------------------------------- */
+// @returns number of values out of tolerance, and the worst of them.
+static size_t compare(const vector<double> & a, const vector<double> & b, const Tolerance & tol,
+		size_t & first, double & maxDiff)
+{
+  size_t nBad = 0;
+  maxDiff = 0.0;
+
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    if (a[i] == b[i] || (std::isnan(a[i]) && std::isnan(b[i])))
+      continue;
+
+    double diff = fabs(a[i] - b[i]);
+    if (std::isnan(diff) || diff > tol.absolute + tol.relative * fabs(a[i]))
+    {
+      if (nBad++ == 0)
+        first = i;
+      if (!(diff <= maxDiff))
+        maxDiff = diff;
+    }
+  }
+  return nBad;
+}
+
+
+/* -------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+  vector<Tolerance> tols;
+  vector<string> files;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    if (arg == "-tol" && i < argc-1) { if (!readTolerances(argv[++i], tols)) return 2; } else
+    if (arg == "-v") verbose = true; else
+    if (arg[0] != '-') files.push_back(arg); else
+      files.clear(), i = argc;
+  }
+
+  if (files.size() != 2)
+  {
+    cerr << "Usage: bench_ncdiff [-tol file] [-v] golden.nc new.nc" << endl;
+    return 2;
+  }
+
+  int nDiffer = 0;
+  size_t nVars = 0;
+
+  try
+  {
+    NcFile golden(files[0], NcFile::read), test(files[1], NcFile::read);
+
+    multimap<string, NcDim> gdims = golden.getDims(), tdims = test.getDims();
+    set<string> dimNames;
+    for (auto & d : gdims) dimNames.insert(d.first);
+    for (auto & d : tdims) dimNames.insert(d.first);
+    for (const string & name : dimNames)
+    {
+      if (gdims.count(name) == 0 || tdims.count(name) == 0)
+      {
+        cout << "  " << name << ": dimension only in " << files[gdims.count(name) ? 0 : 1] << endl;
+        ++nDiffer;
+      }
+    }
+
+    multimap<string, NcVar> gvars = golden.getVars(), tvars = test.getVars();
+    set<string> varNames;
+    for (auto & v : gvars) varNames.insert(v.first);
+    for (auto & v : tvars) varNames.insert(v.first);
+    nVars = varNames.size();
+
+    for (const string & name : varNames)
+    {
+      auto g = gvars.find(name), t = tvars.find(name);
+      if (g == gvars.end() || t == tvars.end())
+      {
+        cout << "  " << name << ": only in " << files[g != gvars.end() ? 0 : 1] << endl;
+        ++nDiffer;
+        continue;
+      }
+
+      string gshape = shape(g->second), tshape = shape(t->second);
+      if (gshape != tshape)
+      {
+        cout << "  " << name << ": shape " << gshape << " is now " << tshape << endl;
+        ++nDiffer;
+        continue;
+      }
+
+      vector<double> a = values(g->second), b = values(t->second);
+      Tolerance tol = findTolerance(tols, name);
+      size_t first = 0;
+      double maxDiff;
+      size_t nBad = compare(a, b, tol, first, maxDiff);
+
+      if (nBad)
+      {
+        cout	<< setprecision(9) << "  " << name << ": " << nBad << " of " << a.size() << " values differ"
+		<< ", max " << maxDiff << " (relative " << tol.relative << ", absolute " << tol.absolute
+		<< "), first [" << first << "] " << a[first] << " is now " << b[first] << endl;
+        ++nDiffer;
+      }
+      else
+      if (verbose)
+        cout << "  " << name << ": ok, " << a.size() << " values" << endl;
+    }
+  }
+  catch (const exception & e)
+  {
+    cerr << "bench_ncdiff: " << e.what() << endl;
+    return 2;
+  }
+
+  cout << files[1] << ": " << nVars << " variables, " << nDiffer << " differ" << endl;
+  return nDiffer ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# End-to-end and per-kernel benchmark of process2d on synthetic data.
+# Generates a file per probe family with bench_gen2d, times process2d
+# -profile on each, runs bench_kernels, and prints it all as one JSON
+# object for comparing builds or machines.  The same options give the
+# same files, so results from different builds are comparable.
+#
+# Usage: bench/run.sh [workdir] [bench_gen2d options, e.g. -seconds 120 -rate 500]
+#
+# Programs are looked for next to this script, after scons bench, unless
+# PROCESS2D, BENCH_GEN2D or BENCH_KERNELS say otherwise.  PROCESS2D_OPTS
+# is passed on to process2d (e.g. "-threads 1").
+
+bench=$(dirname "$0")
+process2d=${PROCESS2D:-$bench/../process2d}
+gen2d=${BENCH_GEN2D:-$bench/bench_gen2d}
+kernels=${BENCH_KERNELS:-$bench/bench_kernels}
+
+work=${1:-/tmp/process2d_bench}
+[ $# -gt 0 ] && shift
+mkdir -p "$work" || exit 1
+
+for p in "$process2d" "$gen2d" "$kernels"; do
+  if [ ! -x "$p" ]; then
+    echo "run.sh: no $p, run scons bench first" >&2
+    exit 1
+  fi
+done
+
+# profile probe=X stage=Y key=value ...  ->  {"probe": "X", "stage": "Y", "key": value, ...}
+profile_json()
+{
+  awk 'BEGIN { n = 0 }
+    $1 == "profile" {
+      line = ""
+      for (i = 2; i <= NF; i++) {
+        if (split($i, kv, "=") != 2) { kv[1] = "stage"; kv[2] = $i }
+        if (kv[1] == "probe" || kv[1] == "stage") kv[2] = "\"" kv[2] "\""
+        line = line (line == "" ? "" : ", ") "\"" kv[1] "\": " kv[2]
+      }
+      printf "%s        {%s}", (n++ ? ",\n" : ""), line
+    }
+    END { printf "\n" }'
+}
+
+now() { date +%s.%N; }
+
+echo "{"
+echo "  \"benchmark\": \"process2d\", \"options\": \"$*\", \"process2d_options\": \"$PROCESS2D_OPTS\","
+echo "  \"end_to_end\": ["
+
+first=1
+for family in fast2d:C4 fast2d_v2:C6 cip:C8 2ds:SH hvps:H1 mixed:C4,C8,SH,H1; do
+  name=${family%%:*}
+  probes=${family#*:}
+  file=$work/$name.2d
+
+  "$gen2d" -probes "$probes" "$@" "$file" > /dev/null || exit 1
+  start=$(now)
+  "$process2d" "$file" -o "$work/$name.nc" -profile $PROCESS2D_OPTS > "$work/$name.log" 2>&1
+  status=$?
+  end=$(now)
+  if [ $status -ne 0 ]; then
+    echo "run.sh: process2d failed on $file, see $work/$name.log" >&2
+    exit 1
+  fi
+
+  [ $first -eq 1 ] || echo "    },"
+  first=0
+  echo "    {\"family\": \"$name\", \"probes\": \"$probes\", \"bytes\": $(wc -c < "$file"),"
+  echo "      \"wall_seconds\": $(awk "BEGIN { print $end - $start }"),"
+  echo "      \"profile\": ["
+  profile_json < "$work/$name.log"
+  echo "      ]"
+done
+echo "    }"
+echo "  ],"
+
+printf '  "kernels": '
+"$kernels" | sed '2,$s/^/  /' || exit 1
+echo "}"
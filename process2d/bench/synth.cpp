@@ -0,0 +1,291 @@
+#include "synth.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <arpa/inet.h>
+
+using namespace std;
+
+
+const SynthProbe synthProbes[] = {
+  { "C4", "Fast2DC",	25,  64, "F2DC003",  "_LPO" },
+  { "C6", "Fast2DC_v2",	10,  64, "F2DC002",  "_LPC" },
+  { "C8", "CIP",	25,  64, "CIP001",   "_RWO" },
+  { "SH", "2DS",	10, 128, "SPEC001H", "_2H" },
+  { "SV", "2DS",	10, 128, "SPEC001V", "_2V" },
+  { "H1", "HVPS",	150, 128, "HVPS01",  "_HV" },
+};
+const int nSynthProbes = sizeof(synthProbes) / sizeof(synthProbes[0]);
+
+
+/* -------------------------------------------------------------------- */
+const SynthProbe *findSynthProbe(const string & id)
+{
+  for (int i = 0; i < nSynthProbes; ++i)
+    if (id == synthProbes[i].id)
+      return &synthProbes[i];
+  return 0;
+}
+
+/* -------------------------------------------------------------------- */
+string synthHeader(const vector<const SynthProbe *> & probes)
+{
+  char date[32];
+  snprintf(date, sizeof(date), "%02d/%02d/%04d", synthMonth, synthDay, synthYear);
+
+  ostringstream xml;
+  xml	<< "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n"
+	<< "<OAP version=\"1\">\n"
+	<< " <Institution>NCAR Research Aviation Facility</Institution>\n"
+	<< " <FormatURL>http://www.eol.ucar.edu/raf/Software/OAPfiles.html</FormatURL>\n"
+	<< " <Project>SYNTH</Project>\n"
+	<< " <Platform>N130AR</Platform>\n"
+	<< " <FlightNumber>rf01</FlightNumber>\n"
+	<< " <FlightDate>" << date << "</FlightDate>\n";
+  for (const SynthProbe *p : probes)
+    xml	<< "  <probe id=\"" << p->id << "\" type=\"" << p->type
+	<< "\" resolution=\"" << p->resolution << "\" nDiodes=\"" << p->nDiodes
+	<< "\" serialnumber=\"" << p->serialNumber << "\" suffix=\"" << p->suffix << "\"/>\n";
+  xml << "</OAP>\n";
+  return xml.str();
+}
+
+
+/* -------------------------------------------------------------------- */
+ParticleSynth::ParticleSynth(const SynthParams & params, int nDiodes, unsigned seed)
+  : _params(params), _nDiodes(nDiodes), _rng(seed),
+    _size(params.shape, (params.meanSize > 0 ? params.meanSize : (nDiodes > 64 ? 10 : 6)) / params.shape),
+    _U(0.0, 1.0)
+{
+}
+
+/* -------------------------------------------------------------------- */
+int ParticleSynth::Next(ParticleImage & img)
+{
+  double d = max(1.0, _size(_rng));
+  double w = d * (0.6 + 0.7 * _U(_rng));
+  double cx = -w/3 + (_nDiodes - 1 + 2*w/3) * _U(_rng);	// Some hang off the edge.
+  int h = min(max(1, (int)lround(d)), img.maxSlices());
+  bool hole = d > 6 && _U(_rng) < _params.holes;
+
+  for (int i = 0; i < h; ++i)
+  {
+    uint64_t *row = img.row(i);
+    for (int k = 0; k < img.nWords(); ++k)
+      row[k] = 0;
+
+    double y = (i + 0.5 - h/2.0) / (h/2.0);
+    double half = w/2 * sqrt(max(0.0, 1 - y*y));
+    int first = max(0, (int)ceil(cx - half - 0.3)), last = min(_nDiodes-1, (int)floor(cx + half + 0.3));
+    bool empty = true;
+
+    for (int j = first; j <= last; ++j)
+    {
+      if (hole && fabs(j - cx) < half * 0.45 && fabs(y) < 0.45)
+        continue;
+      row[j >> 6] |= 1ULL << (j & 63);
+      empty = false;
+    }
+
+    if (empty && _U(_rng) < 0.7)	// Ragged ends.
+    {
+      int j = min(_nDiodes-1, max(0, (int)cx));
+      row[j >> 6] |= 1ULL << (j & 63);
+    }
+  }
+
+  return h;
+}
+
+
+/* -------------------------------------------------------------------- */
+RecordSynth::RecordSynth(const SynthParams & params, const SynthProbe & probe, unsigned seed)
+  : _params(params), _probe(probe), _sliceBytes(probe.nDiodes / 8),
+    _lastByteFirst(probe.nDiodes == 128 || probe.id[1] == '8'), _rle(probe.id[1] == '8'),
+    _particles(params, probe.nDiodes, seed), _img(512, probe.nDiodes),
+    _t(synthStart + 0.01 * uniform_real_distribution<double>(0, 1)(_particles.rng())),
+    _recTime(synthStart), _end(false)
+{
+}
+
+/* -------------------------------------------------------------------- */
+void RecordSynth::addBytes(const unsigned char *p, int n)
+{
+  vector<unsigned char> & to = _rle ? _raw : _out;
+  to.insert(to.end(), p, p + n);
+}
+
+/* -------------------------------------------------------------------- */
+// Shadowed diodes are 0, the first diode of each byte in its high bit.
+void RecordSynth::addSlice(const uint64_t *row)
+{
+  unsigned char slice[16];
+
+  for (int k = 0; k < _sliceBytes; ++k)
+  {
+    unsigned char b = ~(row[k >> 3] >> ((k & 7) * 8));
+    b = (b * 0x0202020202ULL & 0x010884422010ULL) % 1023;	// Reverse the bits.
+    slice[_lastByteFirst ? _sliceBytes-1-k : k] = b;
+  }
+  addBytes(slice, _sliceBytes);
+}
+
+/* -------------------------------------------------------------------- */
+void RecordSynth::addSync(double t, bool dof)
+{
+  unsigned char slice[16] = { 0 };
+
+  if (_rle)	// CIP; sync slice, then the time slice.
+  {
+    long sfm = (long)t;
+    double usec = (t - sfm) * 1.0e6;
+    long ms = (long)(usec / 1000);
+    uint64_t word = ((uint64_t)(sfm / 3600) << 35) | ((uint64_t)(sfm / 60 % 60) << 29) |
+		((uint64_t)(sfm % 60) << 23) | ((uint64_t)ms << 13) | ((uint64_t)((usec - ms*1000) * 8) & 0x1FFF);
+    memset(slice, 0xAA, 8);
+    addBytes(slice, 8);
+    for (int k = 0; k < 8; ++k)
+      slice[k] = word >> (k * 8);
+    slice[7] = (slice[7] & 0xFE) | dof;
+    addBytes(slice, 8);
+  }
+  else
+  if (_probe.nDiodes == 64)	// Fast2D; sync in the top 2 bytes, big-endian.
+  {
+    uint64_t word;
+    if (strstr(_probe.type, "_v2"))
+      word = (0xAAAAULL << 48) | ((uint64_t)(t * 33.33333333e6) & 0x3FFFFFFFFFFULL);
+    else
+      word = (0xAAAAULL << 48) | ((uint64_t)dof << 40) | ((uint64_t)(t * 12.0e6) & 0xFFFFFFFFFFULL);
+    for (int k = 0; k < 8; ++k)
+      slice[k] = word >> ((7 - k) * 8);
+    addBytes(slice, 8);
+  }
+  else	// SPEC; true airspeed clock in the low bytes, sync in the far 3.
+  {
+    double freq = _probe.resolution / (1.0e6 * _params.tas);
+    uint64_t mask = (_probe.id[0] == 'H') ? 0xFFFFFFFFULL : 0xFFFFFFFFFFFFULL;
+    uint64_t tick = (uint64_t)(t / freq) & mask;
+    for (int k = 0; k < 8; ++k)
+      slice[k] = tick >> (k * 8);
+    slice[13] = slice[14] = slice[15] = 0xAA;
+    addBytes(slice, 16);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/* CIP run length encoding; runs of up to 32 0x00 or 0xFF bytes, or up to
+ * 32 bytes as they are.  A code never straddles two records, the rest of
+ * the record is padded with dummy bytes instead.  Leave the last few raw
+ * bytes for the next particle to carry the run on, unless all.
+ */
+void RecordSynth::encodeRuns(bool all)
+{
+  size_t n = _raw.size(), i = 0;
+
+  while (n - i >= (all ? 1 : 33))
+  {
+    unsigned char code[33];
+    int len;
+    size_t j = i;
+
+    if (_raw[i] == 0x00 || _raw[i] == 0xFF)
+    {
+      while (j < n && _raw[j] == _raw[i] && j - i < 32) ++j;
+      code[0] = (_raw[i] == 0x00 ? 0x80 : 0x40) | (j - i - 1);
+      len = 1;
+    }
+    else
+    {
+      while (j < n && _raw[j] != 0x00 && _raw[j] != 0xFF && j - i < 32) ++j;
+      code[0] = j - i - 1;
+      memcpy(&code[1], &_raw[i], j - i);
+      len = 1 + j - i;
+    }
+
+    size_t room = sizeof(((P2d_rec *)0)->image) - _out.size() % sizeof(((P2d_rec *)0)->image);
+    if ((size_t)len > room)
+      _out.insert(_out.end(), room, 0x20);
+    _out.insert(_out.end(), code, code + len);
+    i = j;
+  }
+
+  _raw.erase(_raw.begin(), _raw.begin() + i);
+}
+
+/* -------------------------------------------------------------------- */
+void RecordSynth::addParticle()
+{
+  mt19937 & rng = _particles.rng();
+  uniform_real_distribution<double> U(0.0, 1.0);
+
+  _t += exponential_distribution<double>(_params.rate)(rng);
+  if (_t > synthStart + _params.seconds)
+  {
+    _end = true;
+    if (_rle)
+      encodeRuns(true);
+    return;
+  }
+
+  // Shattered particles arrive a few microseconds apart.
+  int n = (U(rng) < _params.shatter) ? uniform_int_distribution<int>(2, 6)(rng) : 1;
+  double t = _t;
+  for (int k = 0; k < n; ++k)
+  {
+    if (k > 0)
+      t += 2.0e-6 + 1.8e-5 * U(rng);
+    int nSlices = _particles.Next(_img);
+    for (int i = 0; i < nSlices; ++i)
+      addSlice(_img.row(i));
+    addSync(t, U(rng) < _params.dof);
+  }
+  _t = t;
+
+  if (_rle)
+    encodeRuns(false);
+  _times.push_back(make_pair(_out.size(), _t));
+}
+
+/* -------------------------------------------------------------------- */
+bool RecordSynth::Next(P2d_rec & rec, double & time)
+{
+  const size_t recSize = sizeof(rec.image);
+
+  while (_out.size() < recSize && !_end)
+    addParticle();
+
+  if (_out.empty())
+    return false;
+
+  // Stamp with the last particle that is all in this record.
+  size_t k = 0;
+  for (; k < _times.size() && _times[k].first <= recSize; ++k)
+    _recTime = _times[k].second;
+  _times.erase(_times.begin(), _times.begin() + k);
+  for (auto & t : _times)
+    t.first -= recSize;
+
+  size_t n = min(recSize, _out.size());
+  memcpy(rec.image, _out.data(), n);
+  memset(rec.image + n, _rle ? 0x20 : 0xFF, recSize - n);	// Dummy bytes, or blank slices.
+  _out.erase(_out.begin(), _out.begin() + n);
+
+  long sfm = (long)_recTime;
+  rec.probetype = _probe.id[0];
+  rec.probenumber = _probe.id[1];
+  rec.hour = htons(sfm / 3600);
+  rec.minute = htons(sfm / 60 % 60);
+  rec.second = htons(sfm % 60);
+  rec.year = htons(synthYear);
+  rec.month = htons(synthMonth);
+  rec.day = htons(synthDay);
+  rec.tas = htons(_params.tas);
+  rec.msec = htons((long)((_recTime - sfm) * 1000));
+  rec.overload = 0;
+
+  time = _recTime;
+  return true;
+}
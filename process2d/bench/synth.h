@@ -0,0 +1,127 @@
+#ifndef _synth_h_
+#define _synth_h_
+
+/*
+ * Synthetic OAP data for the benchmarks; particle images with a given size
+ * spectrum, and the records a probe would write for them.
+ */
+#include "../particle.h"
+#include "../record.h"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+
+/**
+ * What to generate.  Sizes are in pixels (diodes), so the same spectrum
+ * gives the same images on any probe.
+ */
+struct SynthParams
+{
+  double seconds = 60;		// Length of the file.
+  double rate = 200;		// Mean particles per second per probe, before shattering.
+  double meanSize = 0;		// Mean diameter, pixels; 0 is 6 for 64 diode probes, 10 for 128.
+  double shape = 1;		// Gamma shape of the size spectrum; 1 is exponential, larger is narrower.
+  double shatter = 0.05;	// Fraction of particles that shatter into 2 to 6 close together.
+  double holes = 0.15;		// Fraction of particles over 6 pixels with a Poisson spot.
+  double dof = 0.1;		// Fraction flagged out of the depth of field (CIP, Fast2D).
+  int tas = 120;		// m/s
+  unsigned seed = 1;
+};
+
+/**
+ * Probe types the generator knows, one of each family.
+ */
+struct SynthProbe
+{
+  const char *id, *type;
+  int resolution, nDiodes;
+  const char *serialNumber, *suffix;
+};
+
+extern const SynthProbe synthProbes[];
+extern const int nSynthProbes;
+
+/// @returns the probe with this two character id, or 0.
+const SynthProbe *findSynthProbe(const std::string & id);
+
+/// XML header for a file of these probes, up to and including </OAP>.
+std::string synthHeader(const std::vector<const SynthProbe *> & probes);
+
+/// Flight date and the time the data starts, seconds from midnight.
+const int synthYear = 2024, synthMonth = 7, synthDay = 24;
+const double synthStart = 12*3600 + 30*60 + 0.4;
+
+
+/**
+ * Particle images, bit-packed as in ParticleImage (1 = shadowed).  Roughly
+ * elliptical, random width and position across the array, some off the
+ * edge, some with a hole in the middle.
+ */
+class ParticleSynth
+{
+public:
+  ParticleSynth(const SynthParams & params, int nDiodes, unsigned seed);
+
+  /**
+   * Draw the next particle into img, up to img.maxSlices() slices.
+   * @returns number of slices.
+   */
+  int Next(ParticleImage & img);
+
+  std::mt19937 & rng() { return _rng; }
+
+private:
+  SynthParams _params;
+  int _nDiodes;
+  std::mt19937 _rng;
+  std::gamma_distribution<double> _size;
+  std::uniform_real_distribution<double> _U;
+};
+
+
+/**
+ * Records for one probe, in time order.  Particles arrive as a Poisson
+ * process, each followed by its sync and time word(s) in the probe's own
+ * format; CIP data is run length encoded.
+ */
+class RecordSynth
+{
+public:
+  RecordSynth(const SynthParams & params, const SynthProbe & probe, unsigned seed);
+
+  /**
+   * Fill in the next record.  The record is stamped with the time of the
+   * last particle it holds, as the probes do.
+   * @param time set to the record time, seconds from midnight.
+   * @returns false once past SynthParams::seconds.
+   */
+  bool Next(P2d_rec & rec, double & time);
+
+  const SynthProbe & probe() const { return _probe; }
+
+private:
+  void addParticle();
+  void addSlice(const uint64_t *row);
+  void addSync(double t, bool dof);
+  void addBytes(const unsigned char *p, int n);
+  void encodeRuns(bool all);
+
+  SynthParams _params;
+  const SynthProbe & _probe;
+  int _sliceBytes;
+  bool _lastByteFirst, _rle;
+  ParticleSynth _particles;
+  ParticleImage _img;
+
+  double _t;			// Time of the last particle.
+  double _recTime;		// Of the record being filled.
+  std::vector<unsigned char> _raw;	// CIP bytes waiting to be run length encoded.
+  std::vector<unsigned char> _out;	// Record image bytes, this one and the next.
+  std::vector<std::pair<size_t, double> > _times;	// Position in _out and time of each particle.
+  bool _end;
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Micro-benchmark for slice unpacking.  Times unpackSlices() against the
+ * byte at a time table loop decode() used before, on the image buffers
+ * of each probe in a 2D file (CIP/PIP decompressed first), and checks
+ * they give the same bits.  The CIP buffers are also run as 32 diode
+ * slices, for the legacy probe layout.
+ *
+ * Usage: bench_unpack file.2d [passes]
+ */
+#include "../SliceUnpack.h"
+#include "../record.h"
+#include "../CIPDecoder.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <string>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+
+/* -------------------------------------------------------------------- */
+static const array<unsigned char, 256> bitReverse = []()
+{
+  array<unsigned char, 256> table{};
+  for (int i = 0; i < 256; ++i)
+    for (int bit = 0; bit < 8; ++bit)
+      if (i & (1 << bit))
+        table[i] |= 0x80 >> bit;
+  return table;
+}();
+
+// The way decode() used to do it, a slice at a time.
+static void packSlice(const unsigned char *slice, int nBytes, bool lastByteFirst, uint64_t *row)
+{
+  for (int w = 0; w < (nBytes + 7) / 8; ++w)
+    row[w] = 0;
+
+  for (int i = 0; i < nBytes; ++i)
+  {
+    unsigned char b = lastByteFirst ? slice[nBytes-1-i] : slice[i];
+    row[i >> 3] |= (uint64_t)(unsigned char)~bitReverse[b] << ((i & 7) * 8);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+struct Slices
+{
+  string name;
+  int sliceBytes;
+  bool lastByteFirst;
+  vector<unsigned char> data;
+};
+
+static void bench(const Slices & s, int passes)
+{
+  int nSlices = s.data.size() / s.sliceBytes;
+  int nWords = (s.sliceBytes + 7) / 8;
+  vector<uint64_t> ref(nSlices * nWords), out(nSlices * nWords);
+  const int perRecord = 4096 / s.sliceBytes;	// Unpack a record's worth at a time.
+
+  auto t0 = chrono::steady_clock::now();
+  for (int p = 0; p < passes; ++p)
+    for (int i = 0; i < nSlices; ++i)
+      packSlice(&s.data[i * s.sliceBytes], s.sliceBytes, s.lastByteFirst, &ref[i * nWords]);
+  auto t1 = chrono::steady_clock::now();
+  for (int p = 0; p < passes; ++p)
+    for (int i = 0; i < nSlices; i += perRecord)
+      unpackSlices(&s.data[i * s.sliceBytes], min(perRecord, nSlices - i), s.sliceBytes,
+		s.lastByteFirst, &out[i * nWords]);
+  auto t2 = chrono::steady_clock::now();
+
+  double mb = (double)s.data.size() * passes / 1.0e6;
+  double old_s = chrono::duration<double>(t1 - t0).count();
+  double new_s = chrono::duration<double>(t2 - t1).count();
+
+  cout	<< s.name << ": " << nSlices << " slices of " << s.sliceBytes * 8 << " diodes" << endl
+	<< "  table loop   : " << mb / old_s << " MB/s" << endl
+	<< "  unpackSlices : " << mb / new_s << " MB/s" << endl
+	<< "  speedup      : " << old_s / new_s << "x" << endl
+	<< "  identical    : " << (ref == out ? "yes" : "NO") << endl;
+}
+
+/* -------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: bench_unpack file.2d [passes]" << endl;
+    return 1;
+  }
+  int passes = argc > 2 ? atoi(argv[2]) : 20;
+
+  ifstream in(argv[1], ios::binary);
+  string file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  size_t pos = file.find("</OAP>");
+  if (pos == string::npos)
+  {
+    cerr << "No XML header in " << argv[1] << endl;
+    return 1;
+  }
+  pos = file.find('\n', pos) + 1;
+
+  // Image buffers per probe, in the same family layout decode() uses.
+  map<string, Slices> probes;
+  map<string, CIPDecoder> decoders;
+  vector<unsigned char> image_buff(CIPDecoder::bufferSize);
+
+  for (; pos + sizeof(P2d_rec) <= file.size(); pos += sizeof(P2d_rec))
+  {
+    const P2d_rec *rec = (const P2d_rec *)&file[pos];
+    string id = string(1, rec->probetype) + rec->probenumber;
+    Slices & s = probes[id];
+    s.name = id;
+
+    if (id[0] == '3' || id[0] == 'S' || id[0] == 'H')
+    {
+      s.sliceBytes = 16; s.lastByteFirst = true;
+      s.data.insert(s.data.end(), rec->image, rec->image + sizeof(rec->image));
+    }
+    else
+    if (id[1] == '8')
+    {
+      s.sliceBytes = 8; s.lastByteFirst = true;
+      const unsigned char *slices;
+      int n = decoders[id].Decode(rec->image, sizeof(rec->image), image_buff.data(), slices);
+      s.data.insert(s.data.end(), slices, slices + n * 8);
+    }
+    else
+    {
+      s.sliceBytes = 8; s.lastByteFirst = false;
+      s.data.insert(s.data.end(), rec->image, rec->image + sizeof(rec->image));
+    }
+  }
+
+  for (auto & p : probes)
+  {
+    bench(p.second, passes);
+    if (p.first[1] == '8')
+    {
+      Slices legacy = p.second;
+      legacy.name += " as 32 diode";
+      legacy.sliceBytes = 4; legacy.lastByteFirst = false;
+      bench(legacy, passes);
+    }
+  }
+
+  return 0;
+}
@@ -2,6 +2,8 @@
 #define _config_h_
 
 #include <string>
+#include <vector>
+#include <utility>
 #include <ctime>
 
 /**
@@ -21,10 +23,27 @@ public:
    */
   enum SizeMethod	{ CIRCLE, X, Y, EQUIV_AREA_DIAM };
 
-  Config() : nInterarrivalBins(40), firstBin(0), shattercorrect(true), eawmethod(CENTER_IN), smethod(CIRCLE), verbose(false), debug(false) {}
+  /**
+   * Short tag for a sizing / acceptance combination, used in variable
+   * suffixes and -methods: C, X, Y or E for the sizing method, then A, C or
+   * R for all-in, center-in or reconstruction.  e.g. "XA".
+   */
+  static std::string methodTag(SizeMethod sm, Method em)
+  {
+    return std::string(1, "CXYE"[sm]) + "ACR"[em];
+  }
+
+  static const char *sizeMethodName(SizeMethod sm)
+  {
+    static const char *names[] = { "Circle", "X", "Y", "Equivalent Area Diameter" };
+    return names[sm];
+  }
+
+  Config() : nInterarrivalBins(40), firstBin(0), shattercorrect(true), eawmethod(CENTER_IN), smethod(CIRCLE), verbose(false), debug(false), nThreads(0), useIndex(false), useCache(false), warmStart(false), streamSeconds(0), profile(false) {}
 
   std::string inputFile;
   std::string outputFile;
+  std::string particleFile;	// Per particle output, empty for none.
 
   std::string platform;
   std::string project;
@@ -45,8 +64,23 @@ public:
   Method	eawmethod;	// Particle reconstruction, all-in, center-in
   SizeMethod	smethod;	// Sizing method.
 
+  // More sizing / acceptance methods to bin into their own histograms in the same pass.
+  std::vector<std::pair<SizeMethod, Method> > extraMethods;
+
   bool	verbose;
   bool	debug;
+
+  int	nThreads;	// Decode threads per probe pool, 0 is one per core.
+
+  bool	useIndex;	// Seek with the .2Didx record time index.
+
+  bool	useCache;	// Replay decoded particles from .2Dfeat caches, or build them.
+
+  bool	warmStart;	// Start each interarrival fit from the previous second's.
+
+  int	streamSeconds;	// Write output in blocks of this many seconds, 0 writes it all at the end.
+
+  bool	profile;	// Time each processing stage, report at the end.
 };
 
 #endif
@@ -18,7 +18,7 @@ const char *NetCDF::Category = "CloudAndPrecip";
 
 
 /* -------------------------------------------------------------------- */
-NetCDF::NetCDF(Config & cfg) : _outputFile(cfg.outputFile), _file(0), _mode(NcFile::write)
+NetCDF::NetCDF(Config & cfg) : _outputFile(cfg.outputFile), _file(0), _mode(NcFile::write), _writer(false)
 {
   // No file to pre-open or file does not exist.  Bail out.
   if (_outputFile.size() == 0 || access(_outputFile.c_str(), F_OK))
@@ -76,6 +76,32 @@ void NetCDF::InitVarDB()
   }
 }
 
+/* -------------------------------------------------------------------- */
+void NetCDF::Post(Job job)
+{
+  if (!_writer)
+  {
+    job();
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(_jobLock);
+  _jobTaken.wait(lock, [this]{ return _jobs.size() < maxJobs; });
+  _jobs.push_back(std::move(job));
+  _jobPosted.notify_one();
+}
+
+/* -------------------------------------------------------------------- */
+NetCDF::Job NetCDF::NextJob()
+{
+  std::unique_lock<std::mutex> lock(_jobLock);
+  _jobPosted.wait(lock, [this]{ return !_jobs.empty(); });
+  Job job = std::move(_jobs.front());
+  _jobs.pop_front();
+  _jobTaken.notify_all();
+  return job;
+}
+
 /* -------------------------------------------------------------------- */
 NetCDF::~NetCDF()
 {
@@ -137,10 +163,10 @@ void NetCDF::CreateNetCDFfile(const Config & cfg)
 }
 
 /* -------------------------------------------------------------------- */
-void NetCDF::readTrueAirspeed(float tas[], size_t n)
+void NetCDF::readTrueAirspeed(float tas[], size_t start, size_t n)
 {
-  assert (n == _tas.getDim(0).getSize());
-  _tas.getVar(tas);
+  assert (start + n <= _tas.getDim(0).getSize());
+  _tas.getVar(std::vector<size_t>(1, start), std::vector<size_t>(1, n), tas);
 }
 
 
@@ -259,13 +285,8 @@ NcDim NetCDF::addDimension(const char name[], int size)
 }
 
 /* -------------------------------------------------------------------- */
-NcVar NetCDF::addTimeVariable(const Config & cfg, int size)
+std::string NetCDF::timeUnits(const Config & cfg)
 {
-  _timevar = _file->getVar("Time");
-
-  if (!_timevar.isNull())
-    return _timevar;
-
   char timeunits[70];
   int year, month, day;
   struct tm st;
@@ -274,6 +295,17 @@ NcVar NetCDF::addTimeVariable(const Config & cfg, int size)
 
   sscanf(cfg.flightDate.c_str(), "%d/%d/%d", &month, &day, &year);
   snprintf(timeunits, 70, "seconds since %04d-%02d-%02d %02d:%02d:%02d +0000", year,month,day,st.tm_hour,st.tm_min,st.tm_sec);
+  return timeunits;
+}
+
+/* -------------------------------------------------------------------- */
+NcVar NetCDF::addTimeVariable(const Config & cfg, int size)
+{
+  _timevar = _file->getVar("Time");
+
+  if (!_timevar.isNull())
+    return _timevar;
+
   _timevar = _file->addVar("Time", ncInt, _timedim);
 
   if (_timevar.isNull())
@@ -283,7 +315,7 @@ NcVar NetCDF::addTimeVariable(const Config & cfg, int size)
   }
   putVarAttribute(_timevar, "long_name", "time of measurement");
   putVarAttribute(_timevar, "standard_name", "time");
-  putVarAttribute(_timevar, "units", timeunits);
+  putVarAttribute(_timevar, "units", timeUnits(cfg));
   putVarAttribute(_timevar, "strptime_format", "seconds since %F %T %z");
 
   std::vector<int> time(size);
@@ -455,8 +487,9 @@ NcVar NetCDF::addVariable(string& varname, string& serialNumber)
 
 
 /* -------------------------------------------------------------------- */
-int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
+int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data, size_t start, size_t count)
 {
+  std::vector<size_t> tStart(1, start), tCount(1, count);
   NcVar vconca, vconcr, vplwa, vplwr;
   NcVar vdbara, vdbarr, vdispa, vdispr;
   NcVar vdbza, vdbzr, vreffa, vreffr;
@@ -488,10 +521,10 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
     varname="CONC2DCR150"+probe.suffix; varname[6] = probe.id[0];
     vconc150r = addVariable(varname, probe.serialNumber);
 
-    vconc100a.putVar(&data.all.total_conc100[0]);
-    vconc100r.putVar(&data.round.total_conc100[0]);
-    vconc150a.putVar(&data.all.total_conc150[0]);
-    vconc150r.putVar(&data.round.total_conc150[0]);
+    vconc100a.putVar(tStart, tCount, &data.all.total_conc100[0]);
+    vconc100r.putVar(tStart, tCount, &data.round.total_conc100[0]);
+    vconc150a.putVar(tStart, tCount, &data.all.total_conc150[0]);
+    vconc150r.putVar(tStart, tCount, &data.round.total_conc150[0]);
   }
 
   varname="PLWC2DCR"+probe.suffix; varname[6] = probe.id[0];
@@ -536,22 +569,22 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
   varname="NREJECT2DCA"+probe.suffix; varname[9] = probe.id[0];
   vnreja = addVariable(varname, probe.serialNumber);
 
-  if (!vconca.isNull())  vconca.putVar(&data.all.total_conc[0]);
-  if (!vconcr.isNull())  vconcr.putVar(&data.round.total_conc[0]);
-  if (!vplwr.isNull())   vplwr.putVar(&data.round.lwc[0]);
-  if (!vplwa.isNull())   vplwa.putVar(&data.all.lwc[0]);
-  if (!vdbarr.isNull())  vdbarr.putVar(&data.round.dbar[0]);
-  if (!vdbara.isNull())  vdbara.putVar(&data.all.dbar[0]);
-  if (!vdispr.isNull())  vdispr.putVar(&data.round.disp[0]);
-  if (!vdispa.isNull())  vdispa.putVar(&data.all.disp[0]);
-  if (!vdbzr.isNull())   vdbzr.putVar(&data.round.dbz[0]);
-  if (!vdbza.isNull())   vdbza.putVar(&data.all.dbz[0]);
-  if (!vreffr.isNull())  vreffr.putVar(&data.round.eff_rad[0]);
-  if (!vreffa.isNull())  vreffa.putVar(&data.all.eff_rad[0]);
-  if (!vnaccr.isNull())  vnaccr.putVar(&data.round.accepted[0]);
-  if (!vnacca.isNull())  vnacca.putVar(&data.all.accepted[0]);
-  if (!vnrejr.isNull())  vnrejr.putVar(&data.round.rejected[0]);
-  if (!vnreja.isNull())  vnreja.putVar(&data.all.rejected[0]);
+  if (!vconca.isNull())  vconca.putVar(tStart, tCount, &data.all.total_conc[0]);
+  if (!vconcr.isNull())  vconcr.putVar(tStart, tCount, &data.round.total_conc[0]);
+  if (!vplwr.isNull())   vplwr.putVar(tStart, tCount, &data.round.lwc[0]);
+  if (!vplwa.isNull())   vplwa.putVar(tStart, tCount, &data.all.lwc[0]);
+  if (!vdbarr.isNull())  vdbarr.putVar(tStart, tCount, &data.round.dbar[0]);
+  if (!vdbara.isNull())  vdbara.putVar(tStart, tCount, &data.all.dbar[0]);
+  if (!vdispr.isNull())  vdispr.putVar(tStart, tCount, &data.round.disp[0]);
+  if (!vdispa.isNull())  vdispa.putVar(tStart, tCount, &data.all.disp[0]);
+  if (!vdbzr.isNull())   vdbzr.putVar(tStart, tCount, &data.round.dbz[0]);
+  if (!vdbza.isNull())   vdbza.putVar(tStart, tCount, &data.all.dbz[0]);
+  if (!vreffr.isNull())  vreffr.putVar(tStart, tCount, &data.round.eff_rad[0]);
+  if (!vreffa.isNull())  vreffa.putVar(tStart, tCount, &data.all.eff_rad[0]);
+  if (!vnaccr.isNull())  vnaccr.putVar(tStart, tCount, &data.round.accepted[0]);
+  if (!vnacca.isNull())  vnacca.putVar(tStart, tCount, &data.all.accepted[0]);
+  if (!vnrejr.isNull())  vnrejr.putVar(tStart, tCount, &data.round.rejected[0]);
+  if (!vnreja.isNull())  vnreja.putVar(tStart, tCount, &data.all.rejected[0]);
 
   /* These variables are only output when generating a stand alone netCDF file.
    * i.e. They are not output if the -o command line is specified and it finds
@@ -567,7 +600,7 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
       putVarAttribute(var, "units", "unitless");
       putVarAttribute(var, "long_name", "Interarrival Time Fit Coefficient 1");
     }
-    var.putVar(&data.cpoisson1[0]);
+    var.putVar(tStart, tCount, &data.cpoisson1[0]);
 
     varname="poisson_coeff2"+probe.suffix;
     if ((var = _file->getVar(varname)).isNull()) {
@@ -575,7 +608,7 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
       putVarAttribute(var, "units", "1/seconds");
       putVarAttribute(var, "long_name", "Interarrival Time Fit Coefficient 2");
     }
-    var.putVar(&data.cpoisson2[0]);
+    var.putVar(tStart, tCount, &data.cpoisson2[0]);
 
     varname="poisson_coeff3"+probe.suffix;
     if ((var = _file->getVar(varname)).isNull()) {
@@ -583,7 +616,7 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
       putVarAttribute(var, "units", "1/seconds");
       putVarAttribute(var, "long_name", "Interarrival Time Fit Coefficient 3");
     }
-    var.putVar(&data.cpoisson3[0]);
+    var.putVar(tStart, tCount, &data.cpoisson3[0]);
 
     varname="poisson_cutoff"+probe.suffix;
     if ((var = _file->getVar(varname)).isNull()) {
@@ -591,7 +624,7 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
       putVarAttribute(var, "units", "seconds");
       putVarAttribute(var, "long_name", "Interarrival Time Lower Limit");
     }
-    var.putVar(&data.pcutoff[0]);
+    var.putVar(tStart, tCount, &data.pcutoff[0]);
 
     varname="poisson_correction"+probe.suffix;
     if ((var = _file->getVar(varname)).isNull()) {
@@ -599,7 +632,7 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
       putVarAttribute(var, "units", "unitless");
       putVarAttribute(var, "long_name", "Count/Concentration Correction Factor for Interarrival Rejection");
     }
-    var.putVar(&data.corrfac[0]);
+    var.putVar(tStart, tCount, &data.corrfac[0]);
 
     varname="TAS"+probe.suffix;
     if ((var = _file->getVar(varname)).isNull()) {
@@ -607,7 +640,7 @@ int NetCDF::WriteData(ProbeInfo& probe, ProbeData& data)
       putVarAttribute(var, "units", "m/s");
       putVarAttribute(var, "long_name", "True Air Speed");
     }
-    var.putVar(&data.tas[0]);
+    var.putVar(tStart, tCount, &data.tas[0]);
 
     varname="SA"+probe.suffix;
     if ((var = _file->getVar(varname)).isNull()) {
@@ -4,6 +4,11 @@
 #include <ncAtt.h>
 #include <ncType.h>
 
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+
 class Config;
 class ProbeInfo;
 class ProbeData;
@@ -22,6 +27,29 @@ public:
 
   NcFile *ncid() const { return _file; }
 
+  /**
+   * The netCDF library is not thread safe; hold this around any access
+   * that may run alongside another probe's.
+   */
+  std::mutex & lock() { return _lock; }
+
+  /**
+   * Output from the probe workers, for the single writer thread (see
+   * process2d.cpp), so workers do not block on each other's writes.
+   * Until EnableWriter() there is no writer thread and Post() runs the
+   * job right away.  At most maxJobs wait; Post() blocks beyond that, so
+   * streamed blocks can't pile up in memory behind a slow disk.
+   */
+  typedef std::function<void()> Job;
+
+  void EnableWriter() { _writer = true; }
+  void Post(Job job);
+
+  /**
+   * For the writer thread; wait for and take the oldest job.
+   */
+  Job NextJob();
+
   void CreateNetCDFfile(const Config & cfg);
 
   void CreateDimensions(int numtimes, ProbeInfo &probe, const Config &cfg);
@@ -34,15 +62,24 @@ public:
 
   NcVar addTimeVariable(const Config & cfg, int size);
 
+  /**
+   * Units of the Time variable, seconds since the start time.
+   */
+  static std::string timeUnits(const Config & cfg);
+
   bool hasTASX()
   { return _tas.isNull() ? false : true; }
 
   /**
-   * Check for the existence of TASX.  Read it into provided space.
+   * Check for the existence of TASX.  Read n values starting at time index
+   * start into provided space.
    */
-  void readTrueAirspeed(float tas[], size_t n);
+  void readTrueAirspeed(float tas[], size_t start, size_t n);
 
-  int WriteData(ProbeInfo & probe, ProbeData & data);
+  /**
+   * Write the first count values of data as time indices start onwards.
+   */
+  int WriteData(ProbeInfo & probe, ProbeData & data, size_t start, size_t count);
 
 /*
   NcDim *timedim() const { return _timedim; }
@@ -82,6 +119,14 @@ private:
   NcVar _timevar;
   NcVar _tas;
 
+  std::mutex _lock;
+
+  static const size_t maxJobs = 8;
+  bool _writer;
+  std::mutex _jobLock;
+  std::condition_variable _jobPosted, _jobTaken;
+  std::deque<Job> _jobs;
+
   static const char *ISO8601_Z;
   static const char *Category;
 };
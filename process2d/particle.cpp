@@ -0,0 +1,818 @@
+#include "particle.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+
+//--------Find index for maximum element of an array---------
+int maxindex(std::span<const float> x)
+{
+  int ixmax = 0;
+  double xmax = 0.0;
+  for (size_t i = 0; i < x.size(); i++) {
+    if (x[i] > xmax) {
+      xmax = x[i];
+      ixmax = i;
+    }
+  }
+
+  return ixmax;
+}
+
+
+// ----------------MATRIX INVERSION ROUTINE----------------
+double invert3(double m[3][3], double n[3][3]) {
+   //Invert a 3x3 matrix.  m is original matrix,
+   //n is inverted matrix, det is determinant.  Inverse
+   //is undefined when det is zero.
+   double det;
+   det=m[0][0]*m[1][1]*m[2][2] +
+       m[1][0]*m[2][1]*m[0][2] +
+       m[2][0]*m[0][1]*m[1][2] -
+       m[0][0]*m[2][1]*m[1][2] -
+       m[1][0]*m[0][1]*m[2][2] -
+       m[2][0]*m[1][1]*m[0][2];
+   if (det==0) return det;  //Can't invert
+   n[0][0]=(m[1][1]*m[2][2] - m[1][2]*m[2][1])/det;
+   n[0][1]=(m[0][2]*m[2][1] - m[2][2]*m[0][1])/det;
+   n[0][2]=(m[0][1]*m[1][2] - m[1][1]*m[0][2])/det;
+   n[1][0]=(m[1][2]*m[2][0] - m[2][2]*m[1][0])/det;
+   n[1][1]=(m[0][0]*m[2][2] - m[2][0]*m[0][2])/det;
+   n[1][2]=(m[0][2]*m[1][0] - m[1][2]*m[0][0])/det;
+   n[2][0]=(m[1][0]*m[2][1] - m[2][0]*m[1][1])/det;
+   n[2][1]=(m[0][1]*m[2][0] - m[2][1]*m[0][0])/det;
+   n[2][2]=(m[0][0]*m[1][1] - m[1][0]*m[0][1])/det;
+   return det;
+}
+
+
+void FitStats::add(const FitStats & later)
+{
+   fits += later.fits;
+   lowCounts += later.lowCounts;
+   warmStarts += later.warmStarts;
+   unconverged += later.unconverged;
+   iterations += later.iterations;
+   maxIterations = max(maxIterations, later.maxIterations);
+   if (later.fits || later.lowCounts)
+     lastConverged = later.lastConverged;
+}
+
+void RejectStats::add(const RejectStats & more)
+{
+   particles += more.particles;
+   ireject += more.ireject;
+   wreject += more.wreject;
+   dof += more.dof;
+   interarrival += more.interarrival;
+   areaRatio += more.areaRatio;
+   acceptance += more.acceptance;
+   sizeRange += more.sizeRange;
+   water += more.water;
+}
+
+// ----------------DOUBLE POISSON FIT ROUTINE----------------
+double dpoisson_fit(std::span<const float> x, std::span<const float> y_in, double a[],
+		bool warmStart, FitStats *stats)
+{
+   //update the "a" fit matrix for a double-poisson fit.
+   //Sum of squares of residual values is returned.
+   //Uses the Gauss-Newton nonlinear least squares regression method.
+   //See Numerical Methods for Engineers, Chapra & Canale 1998 p.468
+
+   static thread_local vector<float> y;	//Normalized copy, reused.
+   int n = y_in.size();
+   double kc=log10(exp(1));            //for normalization to 1
+   double ysum=0, olda1;
+   float damp=0.2;                     //Damping factor to prevent runaways
+   int iteration=0, miniterations=5, maxiterations=50;
+   float percentchange=100.0;
+
+   //Normalize to 1
+   y.assign(y_in.begin(), y_in.end());
+   for (int i=0; i<n; i++) ysum += y[i];
+   for (int i=0; i<n; i++) y[i] /= ysum;
+
+   //Don't try with low counts
+   if (ysum < dpoissonMinCounts) {
+      if (stats) { stats->lowCounts++; stats->lastConverged = false; }
+      return -1;
+   }
+
+   //First guess, or carry on from where the last fit ended up.
+   if (!warmStart) {
+      int imax = maxindex(y);
+      a[0] = 0.8;
+      a[1] = 1.0 / x[imax];
+      a[2] = 1.0e6; // 1.0 / (x[imax]/1.0e3);
+   }
+
+   //Iterate function from min to max iteration count, stopping if change is under 1%
+   while (((iteration < maxiterations) && (percentchange > 1.0)) || (iteration < miniterations)){
+      iteration++;
+      //Compute f, difference, and Jacobian for the given "a", each
+      //exponential once per bin, and accumulate JtJ and Jt*diff as we go.
+      double JJt[3][3]={{0}}, JJti[3][3]={{0}}, JtDiff[3]={0};
+      for (int i=0; i<n; i++){
+         double e1 = exp(-a[1]*x[i]), e2 = exp(-a[2]*x[i]);
+         double f=a[0]*a[1]*x[i]*e1*kc+(1.0-a[0])*a[2]*x[i]*e2*kc;
+         double diff=y[i]-f;
+         double J[3];
+         J[0]=a[1]*x[i]*e1*kc-a[2]*x[i]*e2*kc;
+         J[1]=a[0]*x[i]*e1*kc-a[0]*a[1]*x[i]*x[i]*e1*kc;
+         J[2]=(1.0-a[0])*x[i]*e2*kc-(1.0-a[0])*a[2]*x[i]*x[i]*e2*kc;
+         for (int j=0; j<3; j++){
+            for (int k=0; k<3; k++)
+               JJt[j][k]=JJt[j][k]+J[j]*J[k];
+            JtDiff[j]=JtDiff[j]+diff*J[j];
+         }
+      }
+
+      (void)invert3(JJt, JJti);
+
+      //Compute deltaA and update
+      double deltaA[3]={0};
+      for (int i=0; i<3; i++){
+         for (int j=0; j<3; j++){
+            deltaA[i]=deltaA[i] + JtDiff[j] * JJti[i][j];
+         }
+      }
+
+      olda1=a[1];
+      a[0]=a[0]+damp*deltaA[0];
+      a[1]=a[1]+damp*deltaA[1];
+      a[2]=a[2]+damp*deltaA[2];
+      percentchange=100*(abs(a[1])-olda1)/olda1;
+   }
+
+   if (stats) {
+      stats->fits++;
+      if (warmStart) stats->warmStarts++;
+      stats->iterations += iteration;
+      stats->maxIterations = max(stats->maxIterations, iteration);
+      stats->lastConverged = (percentchange <= 1.0) && std::isfinite(a[0]) &&
+		std::isfinite(a[1]) && std::isfinite(a[2]);
+      if (percentchange > 1.0) stats->unconverged++;
+   }
+
+   //Return square of difference
+   double diff2=0;
+   for (int i=0; i<n; i++){
+      double f=a[0]*a[1]*x[i]*exp(-a[1]*x[i])*kc+(1.0-a[0])*a[2]*x[i]*exp(-a[2]*x[i])*kc;
+      diff2=diff2+pow(y[i]-f,2);
+   }
+   return diff2;
+}
+
+
+// ----------------GEOMETRY AND BIT HELPERS----------------
+namespace {
+
+struct Point { double x, y; };
+struct Circle { double x, y, r2; };
+
+inline bool inside(const Circle & c, const Point & p)
+{
+  double dx = p.x - c.x, dy = p.y - c.y;
+  return dx*dx + dy*dy <= c.r2 * (1.0 + 1.0e-12);
+}
+
+inline Circle circle2(const Point & a, const Point & b)
+{
+  Circle c = { (a.x + b.x) / 2, (a.y + b.y) / 2, 0 };
+  double dx = a.x - c.x, dy = a.y - c.y;
+  c.r2 = dx*dx + dy*dy;
+  return c;
+}
+
+inline Circle circle3(const Point & a, const Point & b, const Point & c)
+{
+  double bx = b.x - a.x, by = b.y - a.y, cx = c.x - a.x, cy = c.y - a.y;
+  double d = 2 * (bx*cy - by*cx);
+
+  if (d == 0)	// Collinear, the circle is on the two farthest apart.
+  {
+    Circle ab = circle2(a, b), ac = circle2(a, c), bc = circle2(b, c);
+    return (ab.r2 >= ac.r2 && ab.r2 >= bc.r2) ? ab : (ac.r2 >= bc.r2 ? ac : bc);
+  }
+
+  double b2 = bx*bx + by*by, c2 = cx*cx + cy*cy;
+  double ux = (cy*b2 - by*c2) / d, uy = (bx*c2 - cx*b2) / d;
+  Circle circ = { a.x + ux, a.y + uy, ux*ux + uy*uy };
+  return circ;
+}
+
+// Index of the first bit >= from that is set (or clear, if invert) in row.
+inline int nextBit(const uint64_t *row, int nWords, int from, bool invert)
+{
+  uint64_t flip = invert ? ~0ULL : 0;
+  int w = from >> 6;
+  if (w >= nWords) return nWords * 64;
+  uint64_t bits = (row[w] ^ flip) & (~0ULL << (from & 63));
+  while (bits == 0) {
+    if (++w == nWords) return nWords * 64;
+    bits = row[w] ^ flip;
+  }
+  return w*64 + __builtin_ctzll(bits);
+}
+
+// Turn direction of a-b-c, with the points ordered by slice (y) first.
+inline double turn(const Point & a, const Point & b, const Point & c)
+{
+  return (b.y - a.y) * (c.x - a.x) - (b.x - a.x) * (c.y - a.y);
+}
+
+}
+
+// ----------------FEATURE EXTRACTION----------------
+ParticleFeatures::ParticleFeatures(int nDiodes)
+  : _nDiodes(nDiodes), _nWords((nDiodes + 63) / 64),
+    _lastWord((nDiodes-1) >> 6), _lastBit(1ULL << ((nDiodes-1) & 63))
+{
+  Start();
+}
+
+void ParticleFeatures::Start()
+{
+  _nSlices = 0;
+  _area = 0;
+  _minDiode = _nDiodes; _maxDiode = 0;
+  _minSlice = -1; _maxSlice = 0;
+  _allin = true;
+  _ends.clear();
+  _prevRuns.clear();
+  _runs.clear();
+  _parent.clear();
+  _count.clear();
+  _edge.clear();
+}
+
+void ParticleFeatures::AddSlice(const uint64_t *row)
+{
+  int i = _nSlices++;
+  int first = -1, last = -1;
+
+  // Shadowed pixels, a word of diodes at a time: popcount for area, ctz/clz
+  // for the extent.
+  for (int w = 0; w < _nWords; w++) {
+    uint64_t bits = row[w];
+    if (bits == 0) continue;
+    _area += __builtin_popcountll(bits);
+    if (first < 0) first = w*64 + __builtin_ctzll(bits);
+    last = w*64 + 63 - __builtin_clzll(bits);
+  }
+
+  if (first >= 0) {
+    if ((row[0] & 1) || (row[_lastWord] & _lastBit)) _allin = false;
+    _minDiode = min(_minDiode, first);
+    _maxDiode = max(_maxDiode, last);
+    if (_minSlice < 0) _minSlice = i;
+    _maxSlice = i;
+    _ends.push_back({ i, first, last });
+  }
+
+  /* Holes: label runs of background, joined (union-find) to the runs they
+   * overlap in the slice before.  Each label notes whether it touches the
+   * image edge; the last slice is only known in holeArea().
+   */
+  _prevRuns.swap(_runs);
+  _runs.clear();
+  size_t p = 0;
+  for (int start = nextBit(row, _nWords, 0, true); start < _nDiodes; ) {
+    int end = min(nextBit(row, _nWords, start, false), _nDiodes) - 1;
+    int label = _parent.size();
+    _parent.push_back(label);
+    _count.push_back(end - start + 1);
+    _edge.push_back(i == 0 || start == 0 || end == _nDiodes-1);
+
+    while (p < _prevRuns.size() && _prevRuns[p].last < start) p++;
+    for (size_t q = p; q < _prevRuns.size() && _prevRuns[q].first <= end; q++)
+      merge(label, _prevRuns[q].label);
+
+    _runs.push_back({ start, end, label });
+    start = nextBit(row, _nWords, end+1, true);
+  }
+}
+
+int ParticleFeatures::find(int l)
+{
+  while (_parent[l] != l)
+    l = _parent[l] = _parent[_parent[l]];
+  return l;
+}
+
+void ParticleFeatures::merge(int a, int b)
+{
+  a = find(a); b = find(b);
+  if (a == b) return;
+  if (b < a) swap(a, b);
+  _parent[b] = a;
+  _edge[a] |= _edge[b];
+  _count[a] += _count[b];
+}
+
+int ParticleFeatures::holeArea()
+{
+  for (size_t r = 0; r < _runs.size(); r++)	// Last slice is an edge.
+    _edge[find(_runs[r].label)] = true;
+
+  int area = 0;
+  for (size_t l = 0; l < _parent.size(); l++)
+    if (_parent[l] == (int)l && !_edge[l])
+      area += _count[l];
+  return area;
+}
+
+/* Smallest circle enclosing the convex hull of the slice end points.  The
+ * hull corners are all at the first or last shadowed diode of a slice, so
+ * these are all that is needed.  Build the hull with Andrew's monotone
+ * chain, then run Welzl's algorithm on its corners.
+ */
+static bool enclosingCircle(const vector<Point> & ends,
+			double & xcenter, double & ycenter, double & radius2)
+{
+  static thread_local vector<Point> hull;	// Reused, no allocation per particle.
+
+  if (ends.size() == 0)
+    return false;
+
+  // Lower hull then upper hull; ends is sorted by slice, then diode.
+  size_t n = ends.size();
+  hull.resize(2 * n + 1);
+  size_t k = 0;
+  for (size_t i = 0; i < n; i++) {
+    while (k >= 2 && turn(hull[k-2], hull[k-1], ends[i]) <= 0) k--;
+    hull[k++] = ends[i];
+  }
+  for (size_t i = n-1, t = k+1; i > 0; i--) {
+    while (k >= t && turn(hull[k-2], hull[k-1], ends[i-1]) <= 0) k--;
+    hull[k++] = ends[i-1];
+  }
+  if (n > 1) k--;	// Last point is the first one again.
+
+  // Smallest enclosing circle of the hull corners.
+  Circle c = { hull[0].x, hull[0].y, 0 };
+  for (size_t i = 1; i < k; i++) {
+    if (inside(c, hull[i])) continue;
+    c = { hull[i].x, hull[i].y, 0 };
+    for (size_t j = 0; j < i; j++) {
+      if (inside(c, hull[j])) continue;
+      c = circle2(hull[i], hull[j]);
+      for (size_t m = 0; m < j; m++)
+        if (!inside(c, hull[m]))
+          c = circle3(hull[i], hull[j], hull[m]);
+    }
+  }
+
+  xcenter = c.x;
+  ycenter = c.y;
+  radius2 = c.r2;
+  return true;
+}
+
+bool ParticleFeatures::EnclosingCircle(double & xcenter, double & ycenter, double & radius2) const
+{
+  static thread_local vector<Point> ends;
+  ends.clear();
+
+  for (size_t i = 0; i < _ends.size(); i++) {
+    ends.push_back({ (double)_ends[i].first, (double)_ends[i].slice });
+    if (_ends[i].last != _ends[i].first)
+      ends.push_back({ (double)_ends[i].last, (double)_ends[i].slice });
+  }
+
+  return enclosingCircle(ends, xcenter, ycenter, radius2);
+}
+
+Particle ParticleFeatures::Finish(float res, Config::SizeMethod sizeMethod)
+{
+   Particle particle;
+   float area = _area, theta, phi;
+   double rad, xcenter, ycenter, radius2;
+   int nDiodes = _nDiodes;
+   int minslice = (_minSlice < 0) ? _nSlices : _minSlice;
+
+   particle.allin	= _allin;
+   particle.xsize	= (_maxDiode-_minDiode+1)*res;
+   particle.ysize	= (_maxSlice-minslice+1)*res;
+   // Equivalent Area Diameter sizing.
+   particle.eadsize	= sqrt((area * res * res * 4) / M_PI);
+   particle.area	= area;
+   particle.holearea	= (short)holeArea();
+
+   // Check for empty roi
+   if (!EnclosingCircle(xcenter, ycenter, radius2))
+      return particle;
+
+   // assign properties
+   particle.xcenter = xcenter;
+   particle.ycenter = ycenter;
+   rad = sqrt(radius2) + 0.5;
+
+   //Find area of enclosing circle (in the array)
+   theta = acos(min((particle.xcenter/rad),1.0));            //angle
+   phi = acos(min((nDiodes-1-particle.xcenter)/rad,1.0));
+   // find area= triangles(left) + triangles(right) + (remaining wedges)
+   particle.circlearea = (particle.xcenter*rad*sin(theta) + (nDiodes-1-particle.xcenter)*rad*sin(phi) +
+                       M_PI*rad*rad*((M_PI-phi-theta)/M_PI));
+
+   particle.csize = (rad*2.0)*res;
+   if ((particle.xcenter > 1) && (particle.xcenter < (nDiodes-2)))
+      particle.centerin = true;
+
+   particle.size = particle_size(particle, sizeMethod);
+
+   return particle;
+}
+
+bool minEnclosingCircle(const ParticleImage & img, int nslices,
+			double & xcenter, double & ycenter, double & radius2)
+{
+  static thread_local vector<Point> ends;
+  ends.clear();
+
+  for (int i = 0; i < nslices; i++) {
+    const uint64_t *row = img.row(i);
+    int first = -1, last = -1;
+    for (int w = 0; w < img.nWords(); w++) {
+      if (row[w] == 0) continue;
+      if (first < 0) first = w*64 + __builtin_ctzll(row[w]);
+      last = w*64 + 63 - __builtin_clzll(row[w]);
+    }
+    if (first < 0) continue;
+    ends.push_back({ (double)first, (double)i });
+    if (last != first)
+      ends.push_back({ (double)last, (double)i });
+  }
+
+  return enclosingCircle(ends, xcenter, ycenter, radius2);
+}
+
+// ----------------CIRCLE SIZE ROUTINE----------------
+Particle findsize(	const ParticleImage & img, int nslices, float res,
+			Config::SizeMethod sizeMethod)
+{
+  ParticleFeatures features(img.nDiodes());
+  for (int i = 0; i < nslices; i++)
+    features.AddSlice(img.row(i));
+  return features.Finish(res, sizeMethod);
+}
+
+
+
+// ----------------PARTICLE BATCH----------------
+void ParticleBatch::push_back(const Particle & p)
+{
+  time1hz.push_back(p.time1hz);
+  inttime.push_back(p.inttime);
+  size_.push_back(p.size);
+  csize.push_back(p.csize);
+  xsize.push_back(p.xsize);
+  ysize.push_back(p.ysize);
+  eadsize.push_back(p.eadsize);
+  area.push_back(p.area);
+  holearea.push_back(p.holearea);
+  circlearea.push_back(p.circlearea);
+  xcenter.push_back(p.xcenter);
+  ycenter.push_back(p.ycenter);
+  flags.push_back((p.allin ? ALLIN : 0) | (p.centerin ? CENTERIN : 0) |
+	(p.wreject ? WREJECT : 0) | (p.ireject ? IREJECT : 0) | (p.dofReject ? DOFREJECT : 0));
+}
+
+void ParticleBatch::clear()
+{
+  time1hz.clear(); inttime.clear();
+  size_.clear(); csize.clear(); xsize.clear(); ysize.clear(); eadsize.clear();
+  area.clear(); holearea.clear(); circlearea.clear(); xcenter.clear(); ycenter.clear();
+  flags.clear();
+}
+
+Particle ParticleBatch::operator[](size_t i) const
+{
+  Particle p;
+  p.time1hz = time1hz[i];
+  p.inttime = inttime[i];
+  p.size = size_[i];
+  p.csize = csize[i];
+  p.xsize = xsize[i];
+  p.ysize = ysize[i];
+  p.eadsize = eadsize[i];
+  p.area = area[i];
+  p.holearea = holearea[i];
+  p.circlearea = circlearea[i];
+  p.xcenter = xcenter[i];
+  p.ycenter = ycenter[i];
+  p.allin = flags[i] & ALLIN;
+  p.centerin = flags[i] & CENTERIN;
+  p.wreject = flags[i] & WREJECT;
+  p.ireject = flags[i] & IREJECT;
+  p.dofReject = flags[i] & DOFREJECT;
+  return p;
+}
+
+const vector<float> & ParticleBatch::sizes(Config::SizeMethod sizeMethod) const
+{
+  switch (sizeMethod)	// As particle_size().
+  {
+    case Config::EQUIV_AREA_DIAM:
+      return eadsize;
+
+    case Config::X:
+      return xsize;
+
+    case Config::Y:
+      return ysize;
+
+    case Config::CIRCLE:
+    default:
+      return csize;
+  }
+}
+
+
+// ----------------HOLE FILL ROUTINE----------------
+namespace {
+
+// Run of background pixels [first, last] in one slice.
+struct Run { int slice, first, last, label; };
+
+inline void setBits(uint64_t *row, int first, int last)
+{
+  for (int w = first >> 6; w <= last >> 6; w++) {
+    int lo = max(first, w*64) - w*64, hi = min(last, w*64+63) - w*64;
+    uint64_t mask = (hi == 63 ? ~0ULL : (1ULL << (hi+1)) - 1) & (~0ULL << lo);
+    row[w] |= mask;
+  }
+}
+
+// Scratch space for labelling, reused from one particle to the next.
+struct Labeller
+{
+  vector<Run> runs;
+  vector<int> parent;
+  vector<char> edge;	// Label touches the image edge.
+
+  int find(int l)
+  {
+    while (parent[l] != l)
+      l = parent[l] = parent[parent[l]];
+    return l;
+  }
+
+  void merge(int a, int b)
+  {
+    a = find(a); b = find(b);
+    if (a == b) return;
+    if (b < a) swap(a, b);
+    parent[b] = a;
+    edge[a] |= edge[b];
+  }
+};
+
+}
+
+short fillholes2(ParticleImage & img, int nslices)
+{
+  /* Holes are background pixels not 4-connected to the edge of the image.
+   * Label runs of background one slice at a time, joining a run to the
+   * runs it overlaps in the slice before (union-find), and note on each
+   * label whether it touches an edge.  Then fill every run whose label
+   * never reached an edge.
+   */
+  static thread_local Labeller lab;
+  int nDiodes = img.nDiodes(), nWords = img.nWords();
+  int end = nDiodes;
+  short area_added=0;
+
+  lab.runs.clear();
+  lab.parent.clear();
+  lab.edge.clear();
+
+  size_t prevFirst = 0, prevEnd = 0;
+  for (int i = 0; i < nslices; i++) {
+    const uint64_t *row = img.row(i);
+    bool edgerow = (i == 0 || i == nslices-1);
+    size_t thisFirst = lab.runs.size(), p = prevFirst;
+
+    for (int first = nextBit(row, nWords, 0, true); first < end; ) {
+      int last = min(nextBit(row, nWords, first, false), end) - 1;
+      int label = lab.parent.size();
+      lab.parent.push_back(label);
+      lab.edge.push_back(edgerow || first == 0 || last == nDiodes-1);
+
+      // Join with runs in the slice before that overlap this one.
+      while (p < prevEnd && lab.runs[p].last < first) p++;
+      for (size_t q = p; q < prevEnd && lab.runs[q].first <= last; q++)
+        lab.merge(label, lab.runs[q].label);
+
+      lab.runs.push_back({ i, first, last, label });
+      first = nextBit(row, nWords, last+1, true);
+    }
+    prevFirst = thisFirst;
+    prevEnd = lab.runs.size();
+  }
+
+  for (size_t r = 0; r < lab.runs.size(); r++) {
+    const Run & run = lab.runs[r];
+    if (!lab.edge[lab.find(run.label)]) {
+      setBits(img.row(run.slice), run.first, run.last);
+      area_added += run.last - run.first + 1;
+    }
+  }
+
+  return area_added;
+
+}
+
+// ----------------POISSON SPOT CORRECTION FOR WATER----------------
+float poisson_spot_correction(float area_img, float area_hole, bool allin){
+   //Based on Korolev JTECH #24 2007 p. 376
+   static const float Dspot_Dedge[]={0.003,0.008,0.017,0.024,0.033,0.04,0.047,0.054,0.062,0.072,0.076,0.088,0.093,0.096,
+      0.101,0.119,0.123,0.127,0.13,0.134,0.139,0.148,0.175,0.18,0.184,0.188,0.192,0.195,0.199,0.202,0.206,0.209,
+      0.213,0.217,0.221,0.225,0.23,0.235,0.243,0.327,0.334,0.34,0.345,0.351,0.355,0.36,0.365,0.369,
+      0.373,0.377,0.381,0.385,0.389,0.393,0.397,0.4,0.404,0.408,0.411,0.415,0.419,0.422,0.426,0.429,
+      0.433,0.436,0.439,0.443,0.446,0.45,0.453,0.457,0.46,0.463,0.467,0.47,0.473,0.477,0.48,0.484,0.487,
+      0.49,0.494,0.497,0.501,0.504,0.507,0.511,0.514,0.518,0.521,0.525,0.528,0.532,0.535,0.539,
+      0.543,0.547,0.55,0.554,0.558,0.562,0.566,0.569,0.572,0.575,0.578,0.581,0.584,0.587,0.59,0.593,
+      0.596,0.598,0.601,0.605,0.61,0.614,0.618,0.623,0.627,0.631,0.635,0.64,0.644,0.648,0.653,0.657,
+      0.662,0.666,0.671,0.676,0.68,0.685,0.69,0.695,0.7,0.705,0.711,0.716,0.721,0.727,0.733,0.738,
+      0.744,0.751,0.757,0.763,0.77,0.777,0.784,0.792,0.8,0.808,0.817,0.826,0.836,0.846,0.858,0.87,
+      0.884,0.901,0.921,0.95};
+
+   static const float Dedge_D0[]={1.0,1.054,1.083,1.101,1.095,1.11,1.148,1.162,1.155,1.123,1.182,1.121,1.162,1.21,1.242,
+      1.134,1.166,1.202,1.238,1.27,1.294,1.278,1.13,1.148,1.17,1.194,1.218,1.242,1.265,1.288,1.31,1.331,1.351,
+      1.369,1.386,1.4,1.411,1.416,1.407,1.074,1.08,1.087,1.096,1.106,1.117,1.127,1.139,1.15,1.162,1.173,
+      1.185,1.197,1.208,1.22,1.232,1.243,1.255,1.266,1.277,1.289,1.3,1.311,1.322,1.333,1.344,1.355,
+      1.366,1.376,1.387,1.397,1.407,1.418,1.428,1.438,1.448,1.458,1.467,1.477,1.486,1.496,1.505,1.515,
+      1.524,1.533,1.542,1.551,1.559,1.568,1.577,1.585,1.594,1.602,1.61,1.618,1.626,1.634,1.642,1.65,
+      1.657,1.665,1.673,1.68,1.687,1.694,1.702,1.709,1.716,1.722,1.729,1.736,1.742,1.749,1.755,1.761,
+      1.768,1.774,1.78,1.786,1.791,1.797,1.803,1.808,1.813,1.819,1.824,1.829,1.834,1.839,1.843,1.848,
+      1.852,1.857,1.861,1.865,1.869,1.872,1.876,1.88,1.883,1.886,1.889,1.892,1.895,1.897,1.899,1.901,
+      1.903,1.905,1.906,1.907,1.908,1.908,1.908,1.908,1.907,1.905,1.903,1.9,1.897,1.892,1.885,1.877,1.865,1.845};
+/*
+   float Zd[]={0.0,0.05,0.1,0.15,0.2,0.25,0.3,0.35,0.4,0.45,0.5,0.55,0.6,0.65,0.7,0.75,0.8,0.85,0.9,0.95,1.0,
+      1.05,1.1,1.15,1.2,1.25,1.3,1.35,1.4,1.45,1.5,1.55,1.6,1.65,1.7,1.75,1.8,1.85,1.9,1.95,2.0,2.05,2.1,2.15,2.2,
+      2.25,2.3,2.35,2.4,2.45,2.5,2.55,2.6,2.65,2.7,2.75,2.8,2.85,2.9,2.95,3.0,3.05,3.1,3.15,3.2,3.25,3.3,
+      3.35,3.4,3.45,3.5,3.55,3.6,3.65,3.7,3.75,3.8,3.85,3.9,3.95,4.0,4.05,4.1,4.15,4.2,4.25,4.3,4.35,4.4,
+      4.45,4.5,4.55,4.6,4.65,4.7,4.75,4.8,4.85,4.9,4.95,5.0,5.05,5.1,5.15,5.2,5.25,5.3,5.35,5.4,5.45,5.5,
+      5.55,5.6,5.65,5.7,5.75,5.8,5.85,5.9,5.95,6.0,6.05,6.1,6.15,6.2,6.25,6.3,6.35,6.4,6.45,6.5,6.55,6.6,
+      6.65,6.7,6.75,6.8,6.85,6.9,6.95,7.0,7.05,7.1,7.15,7.2,7.25,7.3,7.35,7.4,7.45,7.5,7.55,7.6,7.65,7.7,
+      7.75,7.8,7.85,7.9,7.95,8.0,8.05,8.1,8.15};
+*/
+   float ratio, correction=1;
+
+   if((area_img>0) && (area_hole>0) && (allin==1)){
+     //Use the area option in paper: sqrt(Sspot/Sedge)
+     ratio = sqrt(area_hole/(area_img+area_hole));
+     int ip=1;
+     while(ip < 164 && ratio > Dspot_Dedge[ip]) ip++;
+//cout<<Zd[ip-1]<<endl;
+     correction = Dedge_D0[ip-1];
+   }
+   return correction;
+}
+
+// ----------------PARTICLE REJECTION ---------------------------
+void water_corrections(const ParticleBatch & batch, float wc[])
+{
+   for (size_t i = 0; i < batch.size(); i++)
+      wc[i] = poisson_spot_correction(batch.area[i], batch.holearea[i], batch.flags[i] & ParticleBatch::ALLIN);
+}
+
+namespace {
+
+// The rejection tests, separately, for counting.
+struct RejectTests { bool dof, interarrival, areaRatio, acceptance, sizeRange, water; };
+
+template <bool countReasons>
+void reject(const ParticleBatch & batch, const float size[],
+		const float nextinttime[], const float wc[], float cutoff, float pixel_res,
+		float smallbin, float largebin, Config::Method eawmethod, uint8_t flags[],
+		RejectStats *stats)
+{
+   //Decides on the rejection of each particle.
+   //No branches in the loop, so it vectorizes.
+   const float *area = batch.area.data(), *holearea = batch.holearea.data(), *circlearea = batch.circlearea.data();
+   const double *inttime = batch.inttime.data();
+   const uint8_t *in = batch.flags.data();
+   const uint8_t keep = ~(ParticleBatch::WREJECT | ParticleBatch::IREJECT);
+   uint8_t need = 0;     // Flag the acceptance method wants set.
+   if (eawmethod == Config::ENTIRE_IN) need = ParticleBatch::ALLIN;
+   if (eawmethod == Config::CENTER_IN) need = ParticleBatch::CENTERIN;
+   double bigsize = pixel_res*10.0;
+
+   for (size_t i = 0; i < batch.size(); i++) {
+      float ar = (area[i]+holearea[i])/circlearea[i];
+      float x = size[i];
+      RejectTests t;
+
+      //Any conditions, starting with dofReject
+      t.dof = (in[i] & ParticleBatch::DOFREJECT) != 0;
+      t.interarrival = (inttime[i] < cutoff) | (nextinttime[i] < cutoff);
+      t.areaRatio = ar < 0.1;
+      t.acceptance = (in[i] & need) != need;
+      bool any = t.dof | t.interarrival | t.areaRatio | t.acceptance;
+
+      //Water conditions
+      t.water = (ar < 0.4) | ((ar < 0.5) & (x > bigsize)) | (x > 6000) |
+                (x/wc[i] < smallbin) | (x/wc[i] > largebin);
+      bool wreject = any | t.water;
+
+      //Ice conditions
+      t.sizeRange = (x < smallbin) | (x > largebin);
+      bool ireject = any | t.sizeRange;
+
+      flags[i] = (in[i] & keep) | (wreject ? ParticleBatch::WREJECT : 0) | (ireject ? ParticleBatch::IREJECT : 0);
+
+      if constexpr (countReasons) {
+         stats->ireject += ireject;
+         stats->wreject += wreject;
+         stats->dof += t.dof;
+         stats->interarrival += t.interarrival;
+         stats->areaRatio += t.areaRatio;
+         stats->acceptance += t.acceptance;
+         stats->sizeRange += t.sizeRange;
+         stats->water += t.water;
+      }
+   }
+
+   if constexpr (countReasons)
+      stats->particles += batch.size();
+}
+
+}
+
+void reject_particles(const ParticleBatch & batch, const float size[],
+                    const float nextinttime[], const float wc[], float cutoff, float pixel_res,
+                    float smallbin, float largebin, Config::Method eawmethod, uint8_t flags[],
+                    RejectStats *stats)
+{
+   if (stats)
+     reject<true>(batch, size, nextinttime, wc, cutoff, pixel_res, smallbin, largebin, eawmethod, flags, stats);
+   else
+     reject<false>(batch, size, nextinttime, wc, cutoff, pixel_res, smallbin, largebin, eawmethod, flags, stats);
+}
+
+//----------------Size of a particle per sizing method--------
+float particle_size(const Particle& x, Config::SizeMethod sizeMethod)
+{
+   switch (sizeMethod)
+   {
+     case Config::EQUIV_AREA_DIAM:
+       return x.eadsize;
+
+     case Config::X:
+       return x.xsize;
+
+     case Config::Y:
+       return x.ysize;
+
+     case Config::CIRCLE:
+     default:
+       return x.csize;  // Default
+   }
+}
+
+//----------------Display particle properties to screen--------
+void showparticle(const Particle& x)
+{
+   float ar;
+   char tbuff[32];
+
+   ar=(x.holearea+x.area)/x.circlearea;
+   cout << setprecision(2);
+   strftime(tbuff, 32, "%H:%M:%S ", gmtime(&x.time1hz));
+   cout << tbuff << x.time1hz << " " << scientific << x.inttime;
+   cout << fixed;
+   cout <<	" C=" << setw(8) << x.csize <<
+		" X=" << setw(8) << x.xsize <<
+		" Y=" << setw(8) << x.ysize <<
+		" AR=" << setw(8) << ar <<
+		" A=" << setw(10) << x.area <<
+		" HA=" << setw(10) << x.holearea <<
+		" CA=" << setw(10) << x.circlearea <<
+		" CenX=" << x.xcenter <<
+		" CenY=" << x.ycenter <<
+		" Int=" << scientific << x.inttime <<
+		" AI=" << x.allin <<
+		" CI=" << x.centerin <<
+		" IR=" << x.ireject <<
+		" WR=" << x.wreject <<
+		" DOFREJ=" << x.dofReject <<
+		endl;
+}
+
+//----------------Display particle image to screen--------
+void showroi(const ParticleImage & img, int nslices)
+{
+  for (int i = 0; i < nslices; i++){
+    for (int j = 0; j < img.nDiodes(); j++) cout<<!img.shadowed(i, j);
+    cout<<endl;
+  }
+  cout<<flush<<endl;
+}
@@ -0,0 +1,260 @@
+#ifndef _particle_h_
+#define _particle_h_
+
+#include <ctime>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+#include "config.h"
+
+
+/**
+ * Bit-packed particle image, one bit per pixel, set where the diode was
+ * shadowed.  Diode j of slice i is bit j%64 of word j/64 in row(i); bits
+ * past nDiodes are always clear.
+ */
+class ParticleImage
+{
+public:
+  ParticleImage(int maxSlices, int nDiodes)
+    : _nDiodes(nDiodes), _nWords((nDiodes + 63) / 64), _bits(maxSlices * _nWords, 0) { }
+
+  int nDiodes() const { return _nDiodes; }
+  int nWords() const { return _nWords; }
+  int maxSlices() const { return _bits.size() / _nWords; }
+
+  uint64_t *row(int i) { return &_bits[i * _nWords]; }
+  const uint64_t *row(int i) const { return &_bits[i * _nWords]; }
+
+  bool shadowed(int i, int j) const { return (row(i)[j >> 6] >> (j & 63)) & 1; }
+
+private:
+  int _nDiodes;
+  int _nWords;
+  std::vector<uint64_t> _bits;
+};
+
+
+class Particle
+{
+public:
+   Particle() : time1hz(0), inttime(0.0), size(0.0), csize(0.0), xsize(0.0), ysize(0.0), eadsize(0.0), area(0.0), holearea(0.0), circlearea(0.0),
+   xcenter(0.0), ycenter(0.0), allin(false), centerin(false), wreject(false), ireject(false), dofReject(false)
+   { }
+
+   bool operator==(const Particle &) const = default;
+
+   long time1hz;
+   double inttime;	// Interarrival time (diff of surrounding time words).
+   float size, csize, xsize, ysize, eadsize, area, holearea, circlearea, xcenter, ycenter;
+   bool allin, centerin, wreject, ireject, dofReject;
+};
+
+
+/**
+ * One second's particles, as structure of arrays; a column per Particle
+ * field and the bools packed into flags.  Rejection and binning only read
+ * a few of the columns, so they run as straight loops over those.  clear()
+ * keeps the storage, so a batch reused from one second to the next stops
+ * allocating once it has seen the busiest second.
+ */
+class ParticleBatch
+{
+public:
+  // Flag bits.
+  enum { ALLIN = 0x01, CENTERIN = 0x02, WREJECT = 0x04, IREJECT = 0x08, DOFREJECT = 0x10 };
+
+  size_t size() const { return inttime.size(); }
+  bool empty() const { return inttime.empty(); }
+
+  void push_back(const Particle & p);
+  void clear();
+
+  /**
+   * Particle i, put back together.
+   */
+  Particle operator[](size_t i) const;
+
+  /**
+   * Column to bin by for a sizing method; csize, xsize, ysize or eadsize.
+   */
+  const std::vector<float> & sizes(Config::SizeMethod sizeMethod) const;
+
+  std::vector<long> time1hz;
+  std::vector<double> inttime;
+  std::vector<float> size_, csize, xsize, ysize, eadsize;
+  std::vector<float> area, holearea, circlearea, xcenter, ycenter;
+  std::vector<uint8_t> flags;
+};
+
+
+/**
+ * Single pass particle feature extraction.  Slices are added one at a time
+ * as they are decoded, and everything sizing needs is gathered on the way:
+ * area, bounding box, edge touch, the first and last shadowed diode of each
+ * slice for the enclosing circle, and holes (runs of background labelled
+ * against the slice before with union-find).  Finish() turns that into a
+ * Particle.  New features go in AddSlice() if they are per slice and in
+ * Finish() if they are per particle, without another pass over the image.
+ *
+ * Storage is reused from one particle to the next.
+ */
+class ParticleFeatures
+{
+public:
+  ParticleFeatures(int nDiodes);
+
+  /**
+   * Start a new particle.
+   */
+  void Start();
+
+  /**
+   * Add the next slice, bit-packed as in ParticleImage.
+   */
+  void AddSlice(const uint64_t *row);
+
+  int nSlices() const { return _nSlices; }
+  int area() const { return _area; }
+  bool allin() const { return _allin; }
+
+  /**
+   * Number of background pixels not connected to the image edge.
+   */
+  int holeArea();
+
+  /**
+   * Smallest circle enclosing the shadowed pixels, in pixel coordinates
+   * (diode, slice).
+   * @returns false if there are no shadowed pixels.
+   */
+  bool EnclosingCircle(double & xcenter, double & ycenter, double & radius2) const;
+
+  /**
+   * Size the particle.  Fills in everything but the time, interarrival and
+   * reject fields.
+   */
+  Particle Finish(float res, Config::SizeMethod sizeMethod);
+
+private:
+  struct RowEnds { int slice, first, last; };
+  struct Run { int first, last, label; };
+
+  int find(int label);
+  void merge(int a, int b);
+
+  int _nDiodes, _nWords, _lastWord;
+  uint64_t _lastBit;
+
+  int _nSlices, _area;
+  int _minDiode, _maxDiode, _minSlice, _maxSlice;
+  bool _allin;
+
+  std::vector<RowEnds> _ends;
+
+  // Hole labelling; runs in the current and previous slice, and per label
+  // union-find parent, pixel count and edge touch.
+  std::vector<Run> _prevRuns, _runs;
+  std::vector<int> _parent, _count;
+  std::vector<char> _edge;
+};
+
+
+/**
+ * Double poisson fit statistics, for tuning and profiling.
+ */
+struct FitStats
+{
+  long fits = 0;		// Fits done.
+  long lowCounts = 0;		// Not fit, too few counts.
+  long warmStarts = 0;		// Started from the previous fit.
+  long unconverged = 0;		// Stopped at the iteration limit.
+  long iterations = 0;		// Total iterations.
+  int maxIterations = 0;	// Most iterations in one fit.
+  bool lastConverged = false;	// Last fit converged; ok to warm start the next.
+
+  // Add in the stats of fits done after these.
+  void add(const FitStats & later);
+};
+
+/**
+ * Particle rejection counts by reason, for profiling.  A particle is
+ * counted under every test it fails.
+ */
+struct RejectStats
+{
+  long particles = 0;		// Particles tested.
+  long ireject = 0;		// Rejected as ice (all),
+  long wreject = 0;		// and as water (round).
+  long dof = 0;			// Flagged out of the depth of field by the probe.
+  long interarrival = 0;	// This or the next interarrival time under the cutoff.
+  long areaRatio = 0;		// Area ratio under 0.1.
+  long acceptance = 0;		// Not all in or center in, per the acceptance method.
+  long sizeRange = 0;		// Outside the size bins.
+  long water = 0;		// Failed the water only tests; area ratio, size, corrected size.
+
+  void add(const RejectStats & more);
+};
+
+/// dpoisson_fit() leaves "a" alone below this many counts.
+const double dpoissonMinCounts = 10;
+
+/**
+ * Double poisson fit of the interarrival time distribution.  Updates the
+ * "a" fit coefficients, returns the sum of squares of the residuals, or
+ * -1 (and "a" is left alone) if there are too few counts.  With warmStart,
+ * start from the coefficients already in "a" instead of a first guess.
+ */
+double dpoisson_fit(std::span<const float> x, std::span<const float> y, double a[],
+		bool warmStart = false, FitStats *stats = 0);
+
+/**
+ * Smallest circle enclosing the shadowed pixels in the first nslices of
+ * img, in pixel coordinates (diode, slice).
+ * @returns false if there are no shadowed pixels.
+ */
+bool minEnclosingCircle(const ParticleImage & img, int nslices,
+			double & xcenter, double & ycenter, double & radius2);
+
+/**
+ * Size the particle in the first nslices of img, see ParticleFeatures.
+ */
+Particle findsize(const ParticleImage & img, int nslices, float res,
+		Config::SizeMethod sizeMethod);
+
+/**
+ * Fill enclosed holes in the first nslices of img.
+ * @returns number of pixels filled.
+ */
+short fillholes2(ParticleImage & img, int nslices);
+
+float poisson_spot_correction(float area_img, float area_hole, bool allin);
+
+/**
+ * Particle size to bin by for a sizing method; csize, xsize, ysize or eadsize.
+ */
+float particle_size(const Particle& x, Config::SizeMethod sizeMethod);
+
+/**
+ * poisson_spot_correction() of each particle in the batch, into wc.
+ */
+void water_corrections(const ParticleBatch & batch, float wc[]);
+
+/**
+ * Decide on the rejection of each particle in the batch, for one sizing
+ * method.  Sets WREJECT and IREJECT in flags, the other bits are copied
+ * from the batch.  Counts the reasons into stats, if given.
+ * @param size to bin by, per particle.
+ * @param nextinttime interarrival time of the particle after, per particle.
+ * @param wc water size correction, per particle.
+ */
+void reject_particles(const ParticleBatch & batch, const float size[],
+		const float nextinttime[], const float wc[], float cutoff, float pixel_res,
+		float smallbin, float largebin, Config::Method eawmethod, uint8_t flags[],
+		RejectStats *stats = 0);
+
+void showparticle(const Particle& x);
+void showroi(const ParticleImage & img, int nslices);
+
+#endif
@@ -1,5 +1,26 @@
 #include "probe.h"
 
+BinLookup::BinLookup(const std::vector<float> & endpoints)
+: _edges(endpoints), _nBins(std::max((int)endpoints.size() - 1, 0)), _uniform(false),
+  _first(0.0), _invWidth(0.0)
+{
+  if (_nBins < 2)
+    return;
+
+  double width = ((double)_edges[_nBins] - _edges[0]) / _nBins;
+  if (!(width > 0.0))
+    return;
+
+  _uniform = true;
+  for (int i = 0; i < _nBins && _uniform; ++i)
+    if (std::fabs((_edges[i+1] - _edges[i]) - width) > width * 1.0e-4)
+      _uniform = false;
+
+  _first = _edges[0];
+  _invWidth = 1.0 / width;
+}
+
+
 void ProbeInfo::SetBinEndpoints(std::string input)
 {
   for(std::string::size_type p0 = 0, p1 = input.find(',');
@@ -20,6 +41,11 @@ void ProbeInfo::ComputeSamplearea(Config::Method eawmethod)
     for (int i = 0; i < numBins+1; ++i)
       bin_endpoints.push_back((i+0.5) * resolution);
 
+  bin_midpoints.clear();
+  dof.clear();
+  eaw.clear();
+  samplearea.clear();
+
   for (int i = 0; i < numBins; ++i)
   {
     float sa, prht, DoF, eff_wid, diam;
@@ -43,4 +69,6 @@ void ProbeInfo::ComputeSamplearea(Config::Method eawmethod)
     eaw.push_back(eff_wid);
     samplearea.push_back(sa);
   }
+
+  binLookup = BinLookup(bin_endpoints);
 }
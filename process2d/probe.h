@@ -14,10 +14,70 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include "config.h"
 
 
+/**
+ * Find the bin a value falls in, given bin endpoints.  Same answer as the
+ * linear scan "while (v > endpoints[bin+1]) bin++", i.e. the bin whose upper
+ * endpoint is the first one >= v, clamped to the last bin.  Evenly spaced
+ * endpoints (the default resolution based bins) are indexed directly, others
+ * (user BIN_EDGES, log spaced interarrival bins) use a branchless binary
+ * search.
+ */
+class BinLookup
+{
+public:
+  BinLookup() : _nBins(0), _uniform(false), _first(0.0), _invWidth(0.0) { }
+  explicit BinLookup(const std::vector<float> & endpoints);
+
+  int operator()(double v) const
+  {
+    if (_nBins <= 1 || !(v > _edges[1]))
+      return 0;
+
+    return _uniform ? direct(v) : search(v);
+  }
+
+  int numBins() const { return _nBins; }
+
+private:
+  int direct(double v) const
+  {
+    double t = (v - _first) * _invWidth;
+    int bin = t < _nBins ? std::max((int)std::ceil(t) - 1, 0) : _nBins - 1;
+
+    // Rounding may put us one off right at an endpoint, settle it exactly.
+    while (bin > 0 && !(v > _edges[bin])) --bin;
+    while (bin < _nBins-1 && v > _edges[bin+1]) ++bin;
+    return bin;
+  }
+
+  int search(double v) const
+  {
+    // Count upper endpoints less than v.
+    const float *base = &_edges[1];
+    int len = _nBins;
+    while (len > 1)
+    {
+      int half = len / 2;
+      base = (base[half] < v) ? base + half : base;
+      len -= half;
+    }
+    int bin = (base - &_edges[1]) + (*base < v);
+    return std::min(bin, _nBins - 1);
+  }
+
+  std::vector<float> _edges;
+  int _nBins;
+  bool _uniform;
+  double _first, _invWidth;
+};
+
+
 /**
  * Probe information.
  */
@@ -105,6 +165,11 @@ public:
    */
   void ComputeSamplearea(Config::Method eawmethod);
 
+  /**
+   * Size bin for a particle, see BinLookup.  Valid after ComputeSamplearea().
+   */
+  int FindBin(float size) const { return binLookup(size); }
+
   std::string type;		// string probe name/type
   std::string id;		// Two byte ID at the front of the data-record.
   std::string serialNumber;
@@ -126,6 +191,7 @@ public:
   std::vector<float> dof;    // Depth Of Field
   std::vector<float> eaw;    // Effective Area Width
   std::vector<float> samplearea;
+  BinLookup binLookup;
 
   // Blank these times per $PROJ_DIR/$PROJECT/$PLATFORM/Production/BlankOAP_rf##
   std::vector<std::pair<time_t, time_t> > blank_out;
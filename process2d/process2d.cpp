@@ -14,13 +14,10 @@
 
 #include <iostream>
 #include <fstream>
-#include <algorithm>
 #include <vector>
-#include <stack>
-#include <cassert>
-#include <cmath>
+#include <thread>
 #include <cstring>
-#include <iomanip>
+#include <cctype>
 #include <ctime>
 #include <unistd.h>
 #include <arpa/inet.h>
@@ -30,9 +27,14 @@
 
 #include "config.h"
 #include "probe.h"
-#include "ProbeData.h"
+#include "record.h"
+#include "ProbeProcessor.h"
+#include "ThreadPool.h"
+#include "TimeIndex.h"
+#include "RecordFile.h"
+#include "ParticleFile.h"
+#include "Profile.h"
 #include "netcdf.h"
-#include "Miniball.hpp"
 
 using namespace std;
 
@@ -41,507 +43,6 @@ int binoffset = 0;	// Offset for RAF conventions, number of empty bins before co
 
 const string markerline = "</OAP>";  // Marks end of XML header
 
-const unsigned char syncString[8] = { 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa };
-
-
-class Particle
-{
-public:
-   Particle() : time1hz(0), inttime(0.0), size(0.0), csize(0.0), xsize(0.0), ysize(0.0), eadsize(0.0), area(0.0), holearea(0.0), circlearea(0.0),
-   allin(false), centerin(false), wreject(false), ireject(false), dofReject(false)
-   { }
-
-   long time1hz;
-   double inttime;	// Interarrival time (diff of surrounding time words).
-   float size, csize, xsize, ysize, eadsize, area, holearea, circlearea, xcenter, ycenter;
-   bool allin, centerin, wreject, ireject, dofReject;
-};
-
-// Standard RAF record format for 2D records.
-typedef struct type_buffer {
-    char probetype;
-    char probenumber;
-    short hour;
-    short minute;
-    short second;
-    short year;
-    short month;
-    short day;
-    short tas;                  // True airspeed.
-    unsigned short msec;        // millisecond of data timestamp.
-    short overload;
-    unsigned char image[4096];
-} P2d_rec;
-
-
-
-/* -------------------------------------------------------------------- */
-long long CIPTimeWord_Microseconds(long long slice)
-{
-  long long output;
-
-  int hour = (slice >> 35) & 0x001F;
-  int minute = (slice >> 29) & 0x003F;
-  int second = (slice >> 23) & 0x003F;
-  int msec = (slice >> 13) & 0x03FF;
-  int usec = slice & 0x1FFF;
-  output = (hour * 3600 + minute * 60 + second);
-  output *= 1000000;
-  output += msec * 1000;
-  output += usec / 8;   // 8 MHz clock or 125nS
-
-//printf("%02d:%02d:%02d.%03d - (%lld)\n", hour, minute, second, msec, output);
-
-  return output;
-}
-
-/* -------------------------------------------------------------------- */
-// DMT CIP/PIP probes are run length encoded.  Decode here.
-int uncompressCIP(unsigned char *dest, const unsigned char src[], int nbytes)
-{
-  int d_idx = 0, i = 0;
-
-  static size_t nResidualBytes = 0;
-  static unsigned char residualBytes[16];
-
-
-  if (nResidualBytes)
-  {
-    memcpy(dest, residualBytes, nResidualBytes);
-    d_idx = nResidualBytes;
-    nResidualBytes = 0;
-  }
-
-  for (; i < nbytes; ++i)
-  {
-    unsigned char b = src[i];
-
-    int nBytes = (b & 0x1F) + 1;
-
-    if ((b & 0x20))     // This is a dummy byte; for alignment purposes.
-    {
-      continue;
-    }
-
-    if ((b & 0xE0) == 0)
-    {
-      memcpy(&dest[d_idx], &src[i+1], nBytes);
-      d_idx += nBytes;
-      i += nBytes;
-    }
-
-    if ((b & 0x80))
-    {
-      memset(&dest[d_idx], 0, nBytes);
-      d_idx += nBytes;
-    }
-    else
-    if ((b & 0x40))
-    {
-      memset(&dest[d_idx], 0xFF, nBytes);
-      d_idx += nBytes;
-    }
-  }
-
-  // Align data.  Find a sync word and put record on mod 8.
-  for (i = 0; i < d_idx; ++i)
-  {
-     if (memcmp(&dest[i], syncString, 8) == 0)
-     {
-       int n = (&dest[i] - dest) % 8;
-       if (n > 0)
-       {
-         memmove(dest, &dest[n], d_idx);
-         d_idx -= n;
-       }
-       break;
-     }
-  }
-
-  if (d_idx % 8)
-  {
-    size_t idx = d_idx / 8 * 8;
-    nResidualBytes = d_idx % 8;
-    memcpy(residualBytes, &dest[idx], nResidualBytes);
-  }
-
-  return d_idx / 8;     // return number of slices.
-}
-
-
-//--------Find index for maximum element of an array---------
-int maxindex(std::vector<float> x)
-{
-  int ixmax = 0;
-  double xmax = 0.0;
-  for (size_t i = 0; i < x.size(); i++) {
-    if (x[i] > xmax) {
-      xmax = x[i];
-      ixmax = i;
-    }
-  }
-
-  return ixmax;
-}
-
-
-// ----------------MATRIX INVERSION ROUTINE----------------
-double invert3(double m[3][3], double n[3][3]) {
-   //Invert a 3x3 matrix.  m is original matrix,
-   //n is inverted matrix, det is determinant.  Inverse
-   //is undefined when det is zero.
-   double det;
-   det=m[0][0]*m[1][1]*m[2][2] +
-       m[1][0]*m[2][1]*m[0][2] +
-       m[2][0]*m[0][1]*m[1][2] -
-       m[0][0]*m[2][1]*m[1][2] -
-       m[1][0]*m[0][1]*m[2][2] -
-       m[2][0]*m[1][1]*m[0][2];
-   if (det==0) return det;  //Can't invert
-   n[0][0]=(m[1][1]*m[2][2] - m[1][2]*m[2][1])/det;
-   n[0][1]=(m[0][2]*m[2][1] - m[2][2]*m[0][1])/det;
-   n[0][2]=(m[0][1]*m[1][2] - m[1][1]*m[0][2])/det;
-   n[1][0]=(m[1][2]*m[2][0] - m[2][2]*m[1][0])/det;
-   n[1][1]=(m[0][0]*m[2][2] - m[2][0]*m[0][2])/det;
-   n[1][2]=(m[0][2]*m[1][0] - m[1][2]*m[0][0])/det;
-   n[2][0]=(m[1][0]*m[2][1] - m[2][0]*m[1][1])/det;
-   n[2][1]=(m[0][1]*m[2][0] - m[2][1]*m[0][0])/det;
-   n[2][2]=(m[0][0]*m[1][1] - m[1][0]*m[0][1])/det;
-   return det;
-}
-
-
-// ----------------DOUBLE POISSON FIT ROUTINE----------------
-double dpoisson_fit(std::vector<float> x, std::vector<float> y, double a[])
-{
-   //update the "a" fit matrix for a double-poisson fit.
-   //Sum of squares of residual values is returned.
-   //Uses the Gauss-Newton nonlinear least squares regression method.
-   //See Numerical Methods for Engineers, Chapra & Canale 1998 p.468
-
-   int n = y.size();
-   double kc, f[n], diff[n], J[3][n];  //The function, difference, and Jacobian
-   kc=log10(exp(1));                   //for normalization to 1
-   double ysum=0, olda1;
-   float damp=0.2;                     //Damping factor to prevent runaways
-   int iteration=0, miniterations=5, maxiterations=50;
-   float percentchange=100.0;
-
-   //for (int i=0; i<n; i++) cout<< y[i]<<", ";
-   //cout<<endl;
-
-   //Normalize to 1
-   for (int i=0; i<n; i++) ysum += y[i];
-   for (int i=0; i<n; i++) y[i] /= ysum;
-
-   //Don't try with low counts
-   if (ysum < 10) return -1;
-
-   //Find first guess
-   int imax = maxindex(y);
-   a[0] = 0.8;
-   a[1] = 1.0 / x[imax];
-   a[2] = 1.0e6; // 1.0 / (x[imax]/1.0e3);
-
-   //Iterate function from min to max iteration count, stopping if change is under 1%
-   while (((iteration < maxiterations) && (percentchange > 1.0)) || (iteration < miniterations)){
-      iteration++;
-      //Compute f, difference, and Jacobian for the given "a"
-      for (int i=0; i<n; i++){
-         f[i]=a[0]*a[1]*x[i]*exp(-a[1]*x[i])*kc+(1.0-a[0])*a[2]*x[i]*exp(-a[2]*x[i])*kc;
-         diff[i]=y[i]-f[i];
-         J[0][i]=a[1]*x[i]*exp(-a[1]*x[i])*kc-a[2]*x[i]*exp(-a[2]*x[i])*kc;
-         J[1][i]=a[0]*x[i]*exp(-a[1]*x[i])*kc-a[0]*a[1]*x[i]*x[i]*exp(-a[1]*x[i])*kc;
-         J[2][i]=(1.0-a[0])*x[i]*exp(-a[2]*x[i])*kc-(1.0-a[0])*a[2]*x[i]*x[i]*exp(-a[2]*x[i])*kc;
-      }
-      //Multiply Jacobian by its transpose and invert
-      double JJt[3][3]={{0}}, JJti[3][3]={{0}};
-      for (int i=0; i<3; i++){
-         for (int j=0; j<3; j++){
-            for (int k=0; k<n; k++){
-               JJt[i][j]=JJt[i][j]+J[i][k]*J[j][k];
-            }
-         }
-      }
-
-      (void)invert3(JJt, JJti);
-
-      //Multiply transposed Jacobian by Diff
-      double JtDiff[3]={0};
-      for (int i=0; i<3; i++){
-         for (int j=0; j<n; j++){
-            JtDiff[i]=JtDiff[i]+diff[j]*J[i][j];
-         }
-      }
-
-      //Compute deltaA and update
-      double deltaA[3]={0};
-      for (int i=0; i<3; i++){
-         for (int j=0; j<3; j++){
-            deltaA[i]=deltaA[i] + JtDiff[j] * JJti[i][j];
-         }
-      }
-
-      olda1=a[1];
-      a[0]=a[0]+damp*deltaA[0];
-      a[1]=a[1]+damp*deltaA[1];
-      a[2]=a[2]+damp*deltaA[2];
-      percentchange=100*(abs(a[1])-olda1)/olda1;
-   }
-
-   //Return square of difference
-   double diff2=0;
-   for (int i=0; i<n; i++){
-      f[i]=a[0]*a[1]*x[i]*exp(-a[1]*x[i])*kc+(1.0-a[0])*a[2]*x[i]*exp(-a[2]*x[i])*kc;
-      diff2=diff2+pow(y[i]-f[i],2);
-   }
-   //cout << "A= " << a[0] <<" "<<a[1]<<" "<<a[2]<<" X2= "<<diff2<<endl;
-   //cout << "Iterations= " <<iteration<<endl;
-   return diff2;
-}
-
-
-// ----------------CIRCLE SIZE ROUTINE----------------
-Particle findsize(	short *img[], int nslices, int nDiodes, float res,
-			Config::SizeMethod sizeMethod)
-{
-   // Based on http://tog.acm.org/resources/GraphicsGems/gems/BoundSphere.c
-   // Graphics Gems I, Article by Ritter
-
-   short foreval=0;  //values that indicate background and foreground
-   vector<short> x,y;
-   Particle particle;
-   bool allin=1;
-   float area=0, theta, phi;
-   double rad;
-   int mindiode=nDiodes, maxdiode=0, minslice=nslices, maxslice=0;
-
-   //Stuff x and y vectors, find x and y size, area, check for edge touching
-   //May want to erode image to outline to increase performance.
-   for (int i = 0; i < nslices; i++) for(int j = 0; j < nDiodes; j++) {
-      if(img[i][j]==foreval) {
-         y.push_back(i);
-         x.push_back(j);
-         if((j==0) || (j==nDiodes-1)) allin=0;
-         area++;
-         if(j<mindiode) mindiode=j;
-         if(j>maxdiode) maxdiode=j;
-         if(i<minslice) minslice=i;
-         if(i>maxslice) maxslice=i;
-      }
-   }
-
-   particle.allin	= allin;
-   particle.xsize	= (maxdiode-mindiode+1)*res;
-   particle.ysize	= (maxslice-minslice+1)*res;
-   // Equivalent Area Diameter sizing.
-   particle.eadsize	= sqrt((area * res * res * 4) / M_PI);
-   particle.area	= area;
-
-   // Check for empty roi
-   if (x.size() == 0)
-      return particle;
-
-   //Put coordinates in an array for compatibility with Miniball.hpp
-   typedef double coordtype;   // coordinate type
-   int ndims=2;            // number of dimensions
-   uint npoints=x.size();  // number of points
-   coordtype **coordpointer = new coordtype*[npoints];
-   for (size_t i=0; i<npoints; i++) {
-      coordtype *p = new coordtype[ndims];
-      p[0]=x[i];
-      p[1]=y[i];
-      coordpointer[i]=p;
-   }
-
-   // define the types of iterators through the points and their coordinates
-   typedef coordtype* const* PointIterator;
-   typedef const coordtype* CoordIterator;
-
-   // create an instance of Miniball
-   typedef Miniball::
-     Miniball <Miniball::CoordAccessor<PointIterator, CoordIterator> > MB;
-   MB ball (ndims, coordpointer, coordpointer+npoints);
-
-   // clean up point array
-   for (size_t i=0; i<npoints; ++i)
-     delete[] coordpointer[i];
-   delete[] coordpointer;
-
-   // assign properties
-   particle.xcenter = *ball.center();
-   particle.ycenter = *(ball.center()+1);
-   rad = sqrt(ball.squared_radius()) + 0.5;
-
-   //Find area of enclosing circle (in the array)
-   theta = acos(min((particle.xcenter/rad),1.0));            //angle
-   phi = acos(min((nDiodes-1-particle.xcenter)/rad,1.0));
-   // find area= triangles(left) + triangles(right) + (remaining wedges)
-   particle.circlearea = (particle.xcenter*rad*sin(theta) + (nDiodes-1-particle.xcenter)*rad*sin(phi) +
-                       M_PI*rad*rad*((M_PI-phi-theta)/M_PI));
-
-   particle.csize = (rad*2.0)*res;
-   if ((particle.xcenter > 1) && (particle.xcenter < (nDiodes-2)))
-      particle.centerin = true;
-
-   // Decide which size to use
-   switch (sizeMethod)
-   {
-     case Config::EQUIV_AREA_DIAM:
-       particle.size = particle.eadsize;
-       break;
-
-     case Config::X:
-       particle.size = particle.xsize;
-       break;
-
-     case Config::Y:
-       particle.size = particle.ysize;
-       break;
-
-     case Config::CIRCLE:
-     default:
-       particle.size = particle.csize;  // Default
-   }
-
-   return particle;
-}
-
-
-
-// ----------------HOLE FILL ROUTINE----------------
-short fillholes2(short *img_original[], int nslices, int nDiodes)
-{
-  short img[nslices][nDiodes]; //create a new image for processing
-  short backval=1, foreval=0;  //values that indicate background and foreground
-  short label=1, area_added=0;
-  stack<int> sx, sy;
-  int itest[4], jtest[4];
-  bool edgetouch;
-
-  //Make blank image
-  memset(img, 0, sizeof(img));
-
-  //Check pixels for background values (to be filled)
-  for (int i = 0; i < nslices; i++) {
-     for (int j = 0; j < nDiodes; j++) {
-        if ((img_original[i][j]==backval) && (img[i][j]==0)) {
-           sx.push(i);
-           sy.push(j);
-           img[i][j]=label;
-           while (!sx.empty()) {
-              //Define neighborhood to test
-              itest[0]=max(sx.top()-1,0);         jtest[0]=sy.top();
-              itest[1]=min(sx.top()+1,nslices-1); jtest[1]=sy.top();
-              itest[2]=sx.top();                  jtest[2]=max(sy.top()-1,0);
-              itest[3]=sx.top();                  jtest[3]=min(sy.top()+1,nDiodes-1);
-              sx.pop();  //Element has been used, erase
-              sy.pop();
-              for (int k=0; k<4; k++){
-                 //Check neighborhood for unmarked pixels, label and add them to stack
-                 if ((img_original[itest[k]][jtest[k]]==backval) && (img[itest[k]][jtest[k]]==0)){
-                    sx.push(itest[k]);
-                    sy.push(jtest[k]);
-                    img[itest[k]][jtest[k]]=label;
-                 }
-              }
-           }
-           label++;
-        }
-     }
-  }
-
-  for (short ic=1; ic<label; ic++){      //Run through all possible values 1:c
-     //Check edges for this value
-     edgetouch=0;
-     for (int i=0; i<nslices; i++) if (img[i][0]==ic) edgetouch=1;
-     if (edgetouch==0) for (int i=0; i<nslices; i++) if (img[i][nDiodes-1]==ic) edgetouch=1;
-     if (edgetouch==0) for (int j=0; j<nDiodes; j++) if (img[0][j]==ic) edgetouch=1;
-     if (edgetouch==0) for (int j=0; j<nDiodes; j++) if (img[nslices-1][j]==ic) edgetouch=1;
-     if (edgetouch==0){
-        for (int i=0; i<nslices; i++) for (int j=0; j<nDiodes; j++) {
-           if (img[i][j]==ic) {img_original[i][j]=foreval; area_added++;}
-        }
-     }
-  }
-  return area_added;
-
-}
-
-// ----------------POISSON SPOT CORRECTION FOR WATER----------------
-float poisson_spot_correction(float area_img, float area_hole, bool allin){
-   //Based on Korolev JTECH #24 2007 p. 376
-   float Dspot_Dedge[]={0.003,0.008,0.017,0.024,0.033,0.04,0.047,0.054,0.062,0.072,0.076,0.088,0.093,0.096,
-      0.101,0.119,0.123,0.127,0.13,0.134,0.139,0.148,0.175,0.18,0.184,0.188,0.192,0.195,0.199,0.202,0.206,0.209,
-      0.213,0.217,0.221,0.225,0.23,0.235,0.243,0.327,0.334,0.34,0.345,0.351,0.355,0.36,0.365,0.369,
-      0.373,0.377,0.381,0.385,0.389,0.393,0.397,0.4,0.404,0.408,0.411,0.415,0.419,0.422,0.426,0.429,
-      0.433,0.436,0.439,0.443,0.446,0.45,0.453,0.457,0.46,0.463,0.467,0.47,0.473,0.477,0.48,0.484,0.487,
-      0.49,0.494,0.497,0.501,0.504,0.507,0.511,0.514,0.518,0.521,0.525,0.528,0.532,0.535,0.539,
-      0.543,0.547,0.55,0.554,0.558,0.562,0.566,0.569,0.572,0.575,0.578,0.581,0.584,0.587,0.59,0.593,
-      0.596,0.598,0.601,0.605,0.61,0.614,0.618,0.623,0.627,0.631,0.635,0.64,0.644,0.648,0.653,0.657,
-      0.662,0.666,0.671,0.676,0.68,0.685,0.69,0.695,0.7,0.705,0.711,0.716,0.721,0.727,0.733,0.738,
-      0.744,0.751,0.757,0.763,0.77,0.777,0.784,0.792,0.8,0.808,0.817,0.826,0.836,0.846,0.858,0.87,
-      0.884,0.901,0.921,0.95};
-
-   float Dedge_D0[]={1.0,1.054,1.083,1.101,1.095,1.11,1.148,1.162,1.155,1.123,1.182,1.121,1.162,1.21,1.242,
-      1.134,1.166,1.202,1.238,1.27,1.294,1.278,1.13,1.148,1.17,1.194,1.218,1.242,1.265,1.288,1.31,1.331,1.351,
-      1.369,1.386,1.4,1.411,1.416,1.407,1.074,1.08,1.087,1.096,1.106,1.117,1.127,1.139,1.15,1.162,1.173,
-      1.185,1.197,1.208,1.22,1.232,1.243,1.255,1.266,1.277,1.289,1.3,1.311,1.322,1.333,1.344,1.355,
-      1.366,1.376,1.387,1.397,1.407,1.418,1.428,1.438,1.448,1.458,1.467,1.477,1.486,1.496,1.505,1.515,
-      1.524,1.533,1.542,1.551,1.559,1.568,1.577,1.585,1.594,1.602,1.61,1.618,1.626,1.634,1.642,1.65,
-      1.657,1.665,1.673,1.68,1.687,1.694,1.702,1.709,1.716,1.722,1.729,1.736,1.742,1.749,1.755,1.761,
-      1.768,1.774,1.78,1.786,1.791,1.797,1.803,1.808,1.813,1.819,1.824,1.829,1.834,1.839,1.843,1.848,
-      1.852,1.857,1.861,1.865,1.869,1.872,1.876,1.88,1.883,1.886,1.889,1.892,1.895,1.897,1.899,1.901,
-      1.903,1.905,1.906,1.907,1.908,1.908,1.908,1.908,1.907,1.905,1.903,1.9,1.897,1.892,1.885,1.877,1.865,1.845};
-/*
-   float Zd[]={0.0,0.05,0.1,0.15,0.2,0.25,0.3,0.35,0.4,0.45,0.5,0.55,0.6,0.65,0.7,0.75,0.8,0.85,0.9,0.95,1.0,
-      1.05,1.1,1.15,1.2,1.25,1.3,1.35,1.4,1.45,1.5,1.55,1.6,1.65,1.7,1.75,1.8,1.85,1.9,1.95,2.0,2.05,2.1,2.15,2.2,
-      2.25,2.3,2.35,2.4,2.45,2.5,2.55,2.6,2.65,2.7,2.75,2.8,2.85,2.9,2.95,3.0,3.05,3.1,3.15,3.2,3.25,3.3,
-      3.35,3.4,3.45,3.5,3.55,3.6,3.65,3.7,3.75,3.8,3.85,3.9,3.95,4.0,4.05,4.1,4.15,4.2,4.25,4.3,4.35,4.4,
-      4.45,4.5,4.55,4.6,4.65,4.7,4.75,4.8,4.85,4.9,4.95,5.0,5.05,5.1,5.15,5.2,5.25,5.3,5.35,5.4,5.45,5.5,
-      5.55,5.6,5.65,5.7,5.75,5.8,5.85,5.9,5.95,6.0,6.05,6.1,6.15,6.2,6.25,6.3,6.35,6.4,6.45,6.5,6.55,6.6,
-      6.65,6.7,6.75,6.8,6.85,6.9,6.95,7.0,7.05,7.1,7.15,7.2,7.25,7.3,7.35,7.4,7.45,7.5,7.55,7.6,7.65,7.7,
-      7.75,7.8,7.85,7.9,7.95,8.0,8.05,8.1,8.15};
-*/
-   float ratio, correction=1;
-
-   if((area_img>0) && (area_hole>0) && (allin==1)){
-     //Use the area option in paper: sqrt(Sspot/Sedge)
-     ratio = sqrt(area_hole/(area_img+area_hole));
-     int ip=1;
-     while(ip < 164 && ratio > Dspot_Dedge[ip]) ip++;
-//cout<<Zd[ip-1]<<endl;
-     correction = Dedge_D0[ip-1];
-   }
-   return correction;
-}
-
-// ----------------PARTICLE REJECTION ---------------------------
-void reject_particle(Particle& x, float cutoff, float nextinttime, float pixel_res,
-                    float smallbin, float largebin, float wc, Config::Method eawmethod)
-{
-   //Decides on the rejection of a particle.
-   //Ice rejects will return value of 2 or higher
-   //Water rejects will return value of 1 or higher
-   float ar;
-   ar=(x.area+x.holearea)/x.circlearea;
-   x.wreject = x.ireject = x.dofReject;	// start off with dofReject as answer
-
-   //Any conditions
-   if ((x.inttime < cutoff) || (nextinttime < cutoff)) {x.wreject=1; x.ireject=1;}
-   if (ar < 0.1) {x.wreject=1; x.ireject=1;}
-   if ((eawmethod == Config::ENTIRE_IN) && (x.allin == 0)) {x.wreject=1; x.ireject=1;}
-   if ((eawmethod == Config::CENTER_IN) && (x.centerin == 0)) {x.wreject=1; x.ireject=1;}
-
-   //Water conditions
-   if ((ar < 0.4) || ((ar < 0.5) && (x.size > pixel_res*10.0))) x.wreject=1;
-   if (x.size > 6000) x.wreject=1;
-   if ((x.size/wc < smallbin) or (x.size/wc > largebin)) x.wreject=1;
-
-   //Ice conditions
-   if ((x.size < smallbin) or (x.size > largebin)) x.ireject=1;
-}
-
 // ----------------TIME CONVERSION ---------------------------
 int hms2sfm(int hms)
 {
@@ -553,679 +54,6 @@ int hms2sfm(int hms)
    return sfm;
 }
 
-struct tm getTime(const P2d_rec *rec)
-{
-  struct tm tm;
-
-  memset(&tm, 0, sizeof(struct tm));
-  tm.tm_mday = ntohs(rec->day);
-  tm.tm_mon = ntohs(rec->month) - 1;
-  tm.tm_year = ntohs(rec->year) - 1900;
-  tm.tm_hour = ntohs(rec->hour);
-  tm.tm_min = ntohs(rec->minute);
-  tm.tm_sec = ntohs(rec->second);
-
-  return tm;
-}
-
-time_t GetUserTime(const P2d_rec *rec, string user_time)
-{
-  struct tm ftm, utm;
-
-  ftm = getTime(rec);
-  utm = ftm;
-  if (user_time.length())
-  {
-    int h, m, s;
-    sscanf(user_time.c_str(), "%02d%02d%02d", &h, &m, &s);
-    utm.tm_hour = h;
-    utm.tm_min = m;
-    utm.tm_sec = s;
-  }
-
-  return mktime(&utm);
-}
-
-
-time_t TwoDtime(const P2d_rec *rec)
-{
-  struct tm tm = getTime(rec);
-  return mktime(&tm);
-}
-
-
-//----------------Display particle properties to screen--------
-void showparticle(Particle& x)
-{
-   float ar;
-   char tbuff[32];
-
-   ar=(x.holearea+x.area)/x.circlearea;
-   cout << setprecision(2);
-   strftime(tbuff, 32, "%H:%M:%S ", gmtime(&x.time1hz));
-   cout << tbuff << x.time1hz << " " << scientific << x.inttime;
-   cout << fixed;
-   cout <<	" C=" << setw(8) << x.csize <<
-		" X=" << setw(8) << x.xsize <<
-		" Y=" << setw(8) << x.ysize <<
-		" AR=" << setw(8) << ar <<
-		" A=" << setw(10) << x.area <<
-		" HA=" << setw(10) << x.holearea <<
-		" CA=" << setw(10) << x.circlearea <<
-		" CenX=" << x.xcenter <<
-		" CenY=" << x.ycenter <<
-		" Int=" << scientific << x.inttime <<
-		" AI=" << x.allin <<
-		" CI=" << x.centerin <<
-		" IR=" << x.ireject <<
-		" WR=" << x.wreject <<
-		" DOFREJ=" << x.dofReject <<
-		endl;
-}
-
-//----------------Display particle image to screen--------
-void showroi(short *img[], int nslices, int nDiodes)
-{
-  for (int i = 0; i < nslices; i++){
-    for (int j = 0; j < nDiodes; j++) cout<<img[i][j];
-    cout<<endl;
-  }
-  cout<<flush<<endl;
-}
-
-// ----------------A FEW BYTE SWAPPING ROUTINES----------------
-unsigned long long endianswap_ull(unsigned long long x)
-{
-   x = (x>>56) |
-        ((x<<40) & 0x00FF000000000000ULL) |
-        ((x<<24) & 0x0000FF0000000000ULL) |
-        ((x<<8)  & 0x000000FF00000000ULL) |
-        ((x>>8)  & 0x00000000FF000000ULL) |
-        ((x>>24) & 0x0000000000FF0000ULL) |
-        ((x>>40) & 0x000000000000FF00ULL) |
-        (x<<56);
-        return x;
-}
-
-
-//================================================================================================
-// ------------PROCESS 2D-----------------------
-//================================================================================================
-int process2d(Config & cfg, NetCDF & ncfile, ProbeInfo & probe)
-{
-  /*-----Processing options-------------------------------------------------------
-      start/stop time: In UTC seconds
-      probe2process:   Indicates which probenumber to process C4, C6, etc.
-      pixel_res:       Probe resolution in microns
-      armwidth:        Arm separation in cm
-      eawmethod:       Select effective array width method (reconstruction/all-in/center-in)
-  */
-
-  //-----------Various declarations-----------------------------------------------
-  type_buffer buffer;
-  ifstream input_file;
-  string line;
-  int slice_count=0;
-  uint64_t slice, firsttimeline=0, lasttimeline=0, timeline, difftimeline;
-  double lastbuffertime, buffertime = 0, nextit = 0, freq;
-  bool firsttimeflag = true;
-  float wc = 1.0, tas = 0.1;
-  long last_time1hz=0, itime=0, iit;
-  Particle particle;
-  vector<Particle> particle_stack;
-  char probetype = probe.id[0];
-  char probenumber = probe.id[1];
-
-  // allocate space for roi.
-  int bytesPerSlice = probe.nDiodes / 8;
-  int slicesPerRecord = 4096 / bytesPerSlice;
-  short *roi[slicesPerRecord*3];
-  for (int i = 0; i < slicesPerRecord*3; ++i)
-    roi[i] = new short[probe.nDiodes];
-
-  probe.ComputeSamplearea(cfg.eawmethod);
-
-  //Time setup
-  int numtimes = cfg.stoptime - cfg.starttime + 1;
-
-  assert(numtimes >= 0);
-
-  //Count and concentration arrays setup
-  float *count_all[numtimes], *conc_all[numtimes];
-  float *count_round[numtimes], *conc_round[numtimes];
-
-  // Allocate contiguous data block.
-  size_t N = numtimes * (probe.numBins+binoffset);
-  count_all[0] = new float[N];
-  count_round[0] = new float[N];
-  conc_all[0] = new float[N];
-  conc_round[0] = new float[N];
-
-  //Initialize all these to zero
-  memset((void *)count_all[0], 0, sizeof(float) * N);
-  memset((void *)count_round[0], 0, sizeof(float) * N);
-  memset((void *)conc_all[0], 0, sizeof(float) * N);
-  memset((void *)conc_round[0], 0, sizeof(float) * N);
-
-  // Set up pointers into contiguous data block.
-  for (int i = 1; i < numtimes; i++) {
-    int offset = i * (probe.numBins+binoffset);
-
-    count_all[i] = count_all[0] + offset;
-    count_round[i] = count_round[0] + offset;
-    conc_all[i] = conc_all[0] + offset;
-    conc_round[i] = conc_round[0] + offset;
-  }
-
-  ProbeData data(numtimes);
-
-  // Shattering correction and interarrival setup
-  const int nitq = 400;	// number of interarrival times to keep for fitting
-  int iitq = 0;		// current index of itq
-  double bestfit[3] = { 0.0, 0.0, 0.0 };
-  double itq[nitq]={1};
-
-  int *count_it[numtimes];
-  count_it[0] = new int [numtimes*(cfg.nInterarrivalBins+binoffset)];
-  memset((void *)count_it[0], 0, sizeof(int)*numtimes*(cfg.nInterarrivalBins+binoffset));
-  for (int i = 1; i < numtimes; i++)
-  {
-    count_it[i] = count_it[0] + (i * (cfg.nInterarrivalBins+binoffset));
-  }
-
-  std::vector<float> it_endpoints, it_midpoints, fitspec;
-  for (int i = 0; i <= cfg.nInterarrivalBins; i++)
-    it_endpoints.push_back(pow(10, ((float)i-35)/5.0));
-  for (int i = 0; i < cfg.nInterarrivalBins; i++)
-    it_midpoints.push_back(pow(10, ((float)i-34.5)/5.0));
-
-  if (ncfile.hasTASX())
-    ncfile.readTrueAirspeed(&data.tas[0], numtimes);
-
-
-  //=============Process Particles============================================================
-
-  input_file.open(cfg.inputFile.c_str(), ios::binary);
-
-  //Skip the XML header
-  do getline(input_file, line); while (line.compare(markerline)!=0);
-
-  int buffcount;
-  unsigned char *image_buff = new unsigned char[50000];
-
-  for (buffcount = 0; !input_file.eof(); ++buffcount)
-  {
-     // Read next buffer, compute buffer times
-     do
-     {
-       input_file.read((char*)(&buffer), sizeof(buffer));
-     }
-     while (((buffer.probetype!=probetype)||(buffer.probenumber!=probenumber)) && (!input_file.eof()));
-
-     if (input_file.gcount() < (int)sizeof(buffer))
-       break;
-
-
-     // Copy off / uncompress data buffer.
-     int nSlices = slicesPerRecord;
-     if (probe.rle)
-       nSlices = uncompressCIP(image_buff, buffer.image, sizeof(buffer.image));
-     else
-       memcpy(image_buff, buffer.image, sizeof(buffer.image));
-
-
-     /* set next buffer time.  3V-CPI will decompress into many buffers with
-      * same time stamp.  don't assign lastbuffertime until we have processed
-      * all of them.
-      */
-     {
-     double newbuffertime = TwoDtime(&buffer) + ((double)ntohs(buffer.msec) / 1000);
-     if (newbuffertime != buffertime)
-     {
-       firsttimeflag = true;
-       lastbuffertime = buffertime;
-       buffertime = newbuffertime;
-     }
-     }
-
-     // Record first buffer day for midnight crossings, do not process first record.
-     if (buffcount == 0)
-     {
-       last_time1hz = (long)buffertime;
-       continue;
-     }
-
-     if (buffertime >= cfg.stoptime)
-     {
-       cout << "\n2D record time exceeds netCDF time, exiting loop.\n";
-       break;
-     }
-
-
-     if (cfg.debug)
-       cout << "New buffer : " << fixed << buffertime << " msec=" << ntohs(buffer.msec) << endl;
-
-
-     // Scroll through each slice, look for sync/time slices
-     for (int islice = 0; islice < nSlices; islice++)
-     {
-        bool syncWord = false;
-        bool dofReject = false;
-
-        if (probetype == '3' || probetype == 'S' || probetype == 'H')	// SPEC
-        {
-           slice = *(unsigned long long *)&image_buff[islice*bytesPerSlice];
-
-           // Stored little-endian, check far side of 16 bytes.
-           if (memcmp(&image_buff[(islice*bytesPerSlice)+bytesPerSlice-3], syncString, 3) == 0) {
-              timeline = slice & probe.timingMask;
-              syncWord = true;
-           }
-        }
-        else
-//        if (probetype == 'C' && probenumber == '8')	// CIP
-        if (probenumber == '8')	// CIP or PIP
-        {
-           slice = ((unsigned long long *)image_buff)[islice];
-
-           // Stored big-endian, check near side of 8 bytes.
-           if (memcmp(&image_buff[islice*bytesPerSlice], syncString, 8) == 0) {
-              syncWord = true;
-              ++islice;
-              slice = *(unsigned long long *)&image_buff[islice*bytesPerSlice];
-              timeline = CIPTimeWord_Microseconds(slice);
-              dofReject = (image_buff[islice*8+7] & probe.dofMask);
-           }
-        }
-        else					// Fast2D C/P
-        {
-           slice = endianswap_ull(((unsigned long long *)image_buff)[islice]);
-
-           // Stored big-endian, check near side of 8 bytes.
-           if (memcmp(&image_buff[islice*bytesPerSlice], syncString, 2) == 0) {
-              syncWord = true;
-              timeline = slice & probe.timingMask;
-              dofReject = (image_buff[islice*8+2] & probe.dofMask);
-           }
-        }
-
-        if (syncWord) {	// Found a sync line
-           if (firsttimeflag) {
-              firsttimeline = timeline;
-              firsttimeflag = false;
-           }
-
-           // Look for negative interarrival time, set to zero instead
-           if (timeline < firsttimeline) difftimeline = 0;
-           else difftimeline = timeline - firsttimeline;
-
-           freq = probe.resolution / (1.0e6 * tas);
-           if (probe.clockType == ProbeInfo::FIXED)
-             difftimeline /= probe.clockMhz;
-           else
-             difftimeline *= freq;
-
-           // Process the roi
-           long time1hz = min((long)(lastbuffertime + difftimeline), (long)buffertime);
-
-           if (time1hz >= cfg.starttime) {
-              particle = findsize(roi, slice_count, probe.nDiodes, probe.resolution, cfg.smethod);
-              particle.holearea = fillholes2(roi, slice_count, probe.nDiodes);
-              particle.inttime = timeline - lasttimeline;
-              if (probe.clockType == ProbeInfo::FIXED)
-                particle.inttime /= probe.clockMhz;
-              else
-                particle.inttime *= freq;
-
-              particle.time1hz=time1hz;
-              particle.dofReject = dofReject;
-
-
-              // Update interarrival queue
-              itq[iitq]=particle.inttime;
-              iitq++;
-              if (iitq > (nitq-1)) iitq=0;
-           }
-
-           // Debugging output
-           if (cfg.debug) {
-              cout<<islice<<endl;
-              showparticle(particle);
-              showroi(roi, slice_count, probe.nDiodes);
-           }
-
-           // Check the particle time to see if a new 1-s period has been crossed.
-           // If so, place all particles in count matrix
-           if (time1hz != last_time1hz) {
-              itime = last_time1hz - cfg.starttime;  // time index
-
-              // Make sure particles are in correct time range
-              if (itime >= 0){
-                 if (ncfile.hasTASX() == false)
-                   tas = data.tas[itime]=((float)ntohs(buffer.tas));
-
-                 //Fill interarrival time array with all particles
-//                 for (int i=0; i<particle_stack.size(); i++){
-//                    iit=0;
-//                    while((particle_stack[i].inttime)>it_endpoints[iit+1]) iit++;
-//                    count_it[itime][iit+1]++;   //Add 1 to iit for RAF convention
-//                 }
-
-                 //Interarrival time array, queue version
-                 for (int i=0; i<nitq; i++){
-                    iit=0;
-                    if (itq[i] < it_endpoints[cfg.nInterarrivalBins]) {  // This should be the largest time allowable
-                       while((itq[i])>it_endpoints[iit+1]) iit++;
-                       count_it[itime][iit+binoffset]++;   //Add offset to iit for RAF convention
-                    }
-                 }
-
-                 fitspec.clear();
-                 for (int i = 0; i < cfg.nInterarrivalBins; i++)
-                   fitspec.push_back(count_it[itime][i+binoffset]);
-                 dpoisson_fit(it_midpoints, fitspec, bestfit);
-                 data.cpoisson1[itime]=(float)bestfit[0];  //Save factors
-                 data.cpoisson2[itime]=(float)bestfit[1];
-                 data.cpoisson3[itime]=(float)bestfit[2];
-
-                 // Compute shattering corrections if flagged
-                 if (cfg.shattercorrect) {
-                   data.pcutoff[itime]=(float)(1.0/bestfit[1]*0.05);  // Compute cutoff time
-                   data.corrfac[itime]=(float)(1.0/(2*exp(-data.pcutoff[itime]*bestfit[1])-1));  //Compute correction factor
-                 } else {
-                   data.pcutoff[itime]=0;   // No rejection or corrections
-                   data.corrfac[itime]=1.0;
-                 }
-
-                 if (cfg.verbose) cout<<itime+cfg.starttime<<" "<<time1hz<<" "<<particle_stack.size()<<" "<<bestfit[0]<<" "<<bestfit[1]<<" "<<bestfit[2]<<endl;
-
-                 // Sort through all particles in this stack
-                 if (cfg.debug) cout << "particle stack size : " << particle_stack.size() << endl;
-                 for (size_t i = 0; i < particle_stack.size(); i++) {
-                    //Find water size correction
-                    if (cfg.smethod == Config::EQUIV_AREA_DIAM)
-                      wc = 1.0;
-                    else
-                      wc = poisson_spot_correction(
-					particle_stack[i].area,
-					particle_stack[i].holearea,
-					particle_stack[i].allin);
-
-                    // Rejection
-                    if (i == particle_stack.size()-1)
-                      nextit = particle.inttime;  //This particle is for next time period, but use its inttime
-                    else
-                      nextit = particle_stack[i+1].inttime;
-
-                    reject_particle(	particle_stack[i], data.pcutoff[itime], nextit,
-					probe.resolution, probe.bin_endpoints[0],
-					probe.bin_endpoints[probe.numBins], wc, cfg.eawmethod);
-                    if (cfg.debug) showparticle(particle_stack[i]);
-
-                    // Fill count arrays with accepted particles
-                    if (!particle_stack[i].ireject){
-                       int bin = 0;
-                       while((particle_stack[i].size)>probe.bin_endpoints[bin+1]) bin++;
-                       count_all[itime][bin+binoffset]++;   //Add offset to bin for RAF convention
-                       data.all.accepted[itime]++;
-                    } else data.all.rejected[itime]++;
-                    if (!particle_stack[i].wreject){
-                       int bin = 0;
-                       while((particle_stack[i].size/wc)>probe.bin_endpoints[bin+1]) bin++;
-                       count_round[itime][bin+binoffset]++;   //Add offset to bin for RAF convention
-                       data.round.accepted[itime]++;
-                    } else
-                       data.round.rejected[itime]++;
-                 } // End sorting through particle stack
-              } // End of time check
-
-              // Restart particle stack
-              particle_stack.clear();
-              last_time1hz = time1hz;
-           } // End crossed into new time period
-
-           // Add this particle to vector
-           particle_stack.push_back(particle);
-
-           // Start a new particle
-           lasttimeline = timeline;
-           slice_count = 0;
-        } // end of image processing after detection of sync line
-        else {
-           // Found an image slice, make the next slice part of binary image
-           int diode = 0;
-           if (probetype == '3' || probetype == 'S' || probetype == 'H')	// SPEC
-           {
-             for (int byte = bytesPerSlice-1; byte >= 0; byte--)
-               for (int bit = 7; bit >= 0; bit--)
-                 roi[slice_count][diode++] = (bool)(image_buff[islice*bytesPerSlice+byte] & (0x01 << bit));
-           }
-           else
-           if (probenumber == '8')	// CIP/PIP
-           {
-             for (int byte = bytesPerSlice-1; byte >= 0; byte--)
-               for (int bit = 7; bit >= 0; bit--)
-                 roi[slice_count][diode++] = (bool)(image_buff[islice*bytesPerSlice+byte] & (0x01 << bit));
-           }
-           else				// Fast 2D C/P
-           {
-             for (int byte = 0; byte < bytesPerSlice; byte++)
-               for (int bit = 7; bit >= 0; bit--)
-                 roi[slice_count][diode++] = (bool)(image_buff[islice*bytesPerSlice+byte] & (0x01 << bit));
-           }
-           slice_count=min(slice_count+1, nSlices-1);  // Increment slice_count, limit to 511
-        }
-     } // end slice loop
-
-     if (!cfg.verbose && (buffcount % 100 == 0))
-       cout	<< ntohs(buffer.hour) << ':' << ntohs(buffer.minute)
-		<< ':' << ntohs(buffer.second) << "." << ntohs(buffer.msec)
-		<< " - " << buffcount << " records    \r" << flush;
-
-  } // end buffer loop
-
-  // Close raw data file
-  input_file.close();
-
-
-  // Free space.
-  delete [] image_buff;
-  for (int i = 0; i < slicesPerRecord*3; ++i)
-    delete [] roi[i];
-
-
-  // Apply blankouts from $PROJ_DIR/$PROJECT/$PLATFORM/Production/BlankOAP.rf##
-  cout << "\nApplying Blankouts...";
-  for (size_t p = 0; p < probe.blank_out.size(); ++p)
-  {
-    int	start_blank = probe.blank_out[p].first - cfg.starttime,
-	end_blank = probe.blank_out[p].second - cfg.starttime;
-    for (int i = 0; i < numtimes; i++)
-    {
-      if (i >= start_blank && i <= end_blank)
-      {
-        for (int bin = binoffset; bin < probe.numBins+binoffset; bin++)
-          count_all[i][bin] = count_round[i][bin] = nan("");
-      }
-    }
-  }
-
-
-  // Compute sample volume, concentration, total number, and LWC
-  cout << "\nComputing derived parameters...";
-
-  float zFac[probe.numBins], dia2[probe.numBins], dia3[probe.numBins];
-  for (int i = 0; i < probe.numBins; i++) {
-    zFac[i] = pow((double)probe.bin_midpoints[i] / 1000.0, 6.0);
-    dia2[i] = probe.bin_midpoints[i] * probe.bin_midpoints[i];
-    dia3[i] = pow((double)probe.bin_midpoints[i], 3.0);
-  }
-
-  // Compute
-  for (int i = 0; i < numtimes; i++)
-  {
-    float dbar2_all = 0.0, dbar2_round = 0.0;
-    float z_all = 0.0, z_round = 0.0;
-
-    for (int bin = binoffset; bin < probe.numBins+binoffset; bin++)
-    {
-      if (data.tas[i] > 0.0) {
-        float sv = probe.samplearea[bin-binoffset] * data.tas[i];  // Sample volume (m3)
-
-        // Correct counts for the poisson fitting
-        if (std::isnan(data.corrfac[i])) data.corrfac[i]=1.0;  //Filter out bad correction factors
-        count_all[i][bin] *= data.corrfac[i];
-        count_round[i][bin] *= data.corrfac[i];
-        conc_all[i][bin] = count_all[i][bin] / sv / 1000.0;	// #/L
-        conc_round[i][bin] = count_round[i][bin] / sv / 1000.0;	// #/L
-
-        if (bin >= 4) { // 100 um and larger (for 2DC).
-          data.all.total_conc100[i] += conc_all[i][bin];
-          data.round.total_conc100[i] += conc_round[i][bin];
-        }
-
-        if (bin >= 6) { // 150 um and larger (for 2DC).
-          data.all.total_conc150[i] += conc_all[i][bin];
-          data.round.total_conc150[i] += conc_round[i][bin];
-        }
-
-        if (bin >= probe.firstBin) {
-          data.all.total_conc[i] += conc_all[i][bin];
-          data.all.dbar[i]	+= conc_all[i][bin] * probe.bin_midpoints[bin-binoffset];
-          dbar2_all		+= conc_all[i][bin] * dia2[bin-binoffset];
-          data.all.lwc[i]	+= conc_all[i][bin] * dia3[bin-binoffset];
-          z_all			+= conc_all[i][bin] * zFac[bin-binoffset];
-
-          data.round.total_conc[i] += conc_round[i][bin];
-          data.round.dbar[i]	+= conc_round[i][bin] * probe.bin_midpoints[bin-binoffset];
-          dbar2_round		+= conc_round[i][bin] * dia2[bin-binoffset];
-          data.round.lwc[i]	+= conc_round[i][bin] * dia3[bin-binoffset];
-          z_round		+= conc_round[i][bin] * zFac[bin-binoffset];
-        }
-        else
-          conc_all[i][bin] = conc_round[i][bin] = 0.0;
-      }
-    }
-
-    if (z_all > 0.0)
-      data.all.dbz[i] = 10.0 * log10((double)(z_all * 1.0e3));
-
-    if (z_round > 0.0)
-      data.round.dbz[i] = 10.0 * log10((double)(z_round * 1.0e3));
-
-    if (data.all.total_conc[i] > 0.0001) {
-      data.all.dbar[i] /= data.all.total_conc[i];
-
-      data.all.disp[i] = (float)sqrt(fabs((double)(dbar2_all /
-                        data.all.total_conc[i] - data.all.dbar[i] *
-                        data.all.dbar[i]))) / data.all.dbar[i];
-    }
-
-    if (data.round.total_conc[i] > 0.0001) {
-      data.round.dbar[i] /= data.round.total_conc[i];
-
-      data.round.disp[i] = (float)sqrt(fabs((double)(dbar2_round /
-                        data.round.total_conc[i] - data.round.dbar[i] *
-                        data.round.dbar[i]))) / data.round.dbar[i];
-    }
-
-    if (dbar2_all > 0.0)
-      data.all.eff_rad[i] = 0.5 * (data.all.lwc[i] / dbar2_all);
-
-    if (dbar2_round > 0.0)
-      data.round.eff_rad[i] = 0.5 * (data.round.lwc[i] / dbar2_round);
-
-    data.all.lwc[i] *= M_PI / 6.0 * 1.0e-9;
-    data.round.lwc[i] *= M_PI / 6.0 * 1.0e-9;
-  }
-
-
-  //=============Replace NAN with missing value (-32767) =====================
-  data.ReplaceNANwithMissingData();
-  for (int i = 0; i < numtimes; i++)
-  {
-    for (int bin = binoffset; bin < probe.numBins+binoffset; bin++)
-    {
-      if (std::isnan(count_all[i][bin]))
-        count_all[i][bin] = conc_all[i][bin] = -32767.0;
-      if (std::isnan(count_round[i][bin]))
-        count_round[i][bin] = conc_round[i][bin] = -32767.0;
-    }
-  }
-
-  //=============Write to netCDF==============================================
-  if (buffcount <= 1) return 1;  //Don't write empty files
-
-  cout << "\nWriting to netCDF file";
-  ncfile.CreateNetCDFfile(cfg);	// Output file; Create as necessary.
-  NcFile *dataFile = ncfile.ncid();
-
-  ncfile.CreateDimensions(numtimes, probe, cfg);
-
-  // Define the variables.
-  NcVar timevar, a2dr, a2da, c2dr, c2da, iaep, i2d;
-  string varname, eawmethodname;
-
-  // Full name for the various effective array width choices
-  if (cfg.eawmethod == Config::RECONSTRUCTION) eawmethodname = "Reconstruction";
-  if (cfg.eawmethod == Config::ENTIRE_IN) eawmethodname = "All-in";
-  if (cfg.eawmethod == Config::CENTER_IN) eawmethodname = "Center-in";
-//  if (cfg.eawmethod == Config::EQUIV_AREA_DIAM) eawmethodname = "Equivalent Area Diameter";
-
-  if ((timevar = ncfile.addTimeVariable(cfg, numtimes)).isNull())
-    return NetCDF::NC_ERR;
-
-  varname = "interarrival_endpoints";
-  if ((iaep = dataFile->getVar(varname)).isNull()) {
-    iaep = dataFile->addVar(varname, ncFloat, ncfile.intbindim());
-  }
-
-  // Counts.  These are not in the ProbeData class yet, hence they are written here. @todo
-  varname="A2DCA"+probe.suffix; varname[3] = probe.id[0];
-  if (!(a2da = ncfile.addHistogram(varname, probe, binoffset)).isNull())
-  {
-    ncfile.putVarAttribute(a2da, "Rejected", "Roundness below 0.1, interarrival time below 1/20th of distribution peak");
-    ncfile.putVarAttribute(a2da, "ParticleAcceptMethod", eawmethodname);
-  }
-
-  varname="A2DCR"+probe.suffix; varname[3] = probe.id[0];
-  if (!(a2dr = ncfile.addHistogram(varname, probe, binoffset)).isNull())
-  {
-    ncfile.putVarAttribute(a2dr, "Rejected", "Roundness below 0.5, interarrival time below 1/20th of distribution peak");
-    ncfile.putVarAttribute(a2dr, "ParticleAcceptMethod", eawmethodname);
-  }
-
-  varname="I2DCA"+probe.suffix; varname[3] = probe.id[0];
-  if (!(i2d = ncfile.addHistogram(varname, probe, binoffset)).isNull())
-  {
-    ncfile.putVarAttribute(i2d, "CellSizes", it_endpoints);
-    ncfile.putVarAttribute(i2d, "CellSizeUnits", "seconds");
-  }
-
-  //Concentration
-  varname="C2DCA"+probe.suffix; varname[3] = probe.id[0];
-  c2da = ncfile.addHistogram(varname, probe, binoffset);
-
-  varname="C2DCR"+probe.suffix; varname[3] = probe.id[0];
-  c2dr = ncfile.addHistogram(varname, probe, binoffset);
-
-  if (!iaep.isNull()) iaep.putVar(&it_endpoints[0]); //, cfg.nInterarrivalBins+1);
-  if (!a2da.isNull()) a2da.putVar(&count_all[0][0]); //, numtimes, 1, probe.numBins+binoffset);
-  if (!a2dr.isNull()) a2dr.putVar(&count_round[0][0]); //, numtimes, 1, probe.numBins+binoffset);
-  if (!i2d.isNull()) i2d.putVar(&count_it[0][0]); //, numtimes, 1, cfg.nInterarrivalBins+binoffset);
-  if (!c2da.isNull()) c2da.putVar(&conc_all[0][0]); //, numtimes, 1, probe.numBins+binoffset);
-  if (!c2dr.isNull()) c2dr.putVar(&conc_round[0][0]); //, numtimes, 1, probe.numBins+binoffset);
-
-  cout << endl;
-
-  delete [] count_all[0];
-  delete [] count_round[0];
-  delete [] conc_all[0];
-  delete [] conc_round[0];
-  delete [] count_it[0];
-
-  return ncfile.WriteData(probe, data);
-}
 
 /* -------------------------------------------------------------------------- */
 string extractElement(const string & line, string name)
@@ -1245,16 +73,43 @@ string extractAttribute(const string & line, string name)
 }
 
 /* -------------------------------------------------------------------------- */
-void Read2dStartEndTime(Config & config, ifstream & input_file)
+bool isProbeRecord(const P2d_rec & rec, const vector<ProbeInfo> & probe_list)
+{
+  for (size_t i = 0; i < probe_list.size(); i++)
+    if (rec.probetype == probe_list[i].id[0] && rec.probenumber == probe_list[i].id[1])
+      return true;
+
+  return false;
+}
+
+/* -------------------------------------------------------------------------- */
+void Read2dStartEndTime(Config & config, ifstream & input_file, const vector<ProbeInfo> & probe_list)
 {
   P2d_rec buffer;
+  streamoff dataStart = input_file.tellg();
 
   // Read first buffer, get start time
   input_file.read((char*)(&buffer), sizeof(buffer));
   config.starttime = GetUserTime(&buffer, config.user_starttime);
 
-  // Read last buffer, get stop time
-  do input_file.read((char*)(&buffer), sizeof(buffer)); while (!input_file.eof());
+  /* Read last buffer, get stop time.  Records are fixed size after the XML
+   * header, so seek back from the end of the file.  Step back over a
+   * partial or garbled record at the end, it won't have a valid probe ID.
+   */
+  input_file.clear();
+  input_file.seekg(0, ios::end);
+  streamoff nRecs = ((streamoff)input_file.tellg() - dataStart) / (streamoff)sizeof(buffer);
+  for (streamoff i = nRecs-1; i >= 0; --i)
+  {
+    P2d_rec last;
+    input_file.seekg(dataStart + i * sizeof(buffer));
+    input_file.read((char*)(&last), sizeof(last));
+    if (isProbeRecord(last, probe_list))
+    {
+      buffer = last;
+      break;
+    }
+  }
   config.stoptime = GetUserTime(&buffer, config.user_stoptime);
 
   cout << "2D file start time: " << ctime(&config.starttime);
@@ -1386,6 +241,41 @@ void ParseHeader(ifstream & input_file, Config & cfg, vector<ProbeInfo> & probe_
   } while ((line.compare(markerline)!=0) && (!input_file.eof()));
 }
 
+/* -------------------------------------------------------------------------- */
+/**
+ * Parse a -methods list; comma separated Config::methodTag()s, e.g. "xa,yc",
+ * or "all" for every combination.
+ */
+void parseMethods(const string & list, Config & config)
+{
+  const char *sizes = "CXYE", *accepts = "ACR";
+
+  if (list == "all")
+  {
+    for (int sm = 0; sm < 4; sm++)
+      for (int em = 0; em < 3; em++)
+        config.extraMethods.push_back(make_pair((Config::SizeMethod)sm, (Config::Method)em));
+    return;
+  }
+
+  for (size_t p0 = 0; p0 < list.size(); )
+  {
+    size_t p1 = list.find(',', p0);
+    if (p1 == string::npos) p1 = list.size();
+    string tag = list.substr(p0, p1-p0);
+    p0 = p1 + 1;
+
+    const char *sm = tag.size() == 2 ? strchr(sizes, toupper(tag[0])) : 0;
+    const char *em = tag.size() == 2 ? strchr(accepts, toupper(tag[1])) : 0;
+    if (sm == 0 || em == 0)
+    {
+      cerr << "Unknown sizing/acceptance method '" << tag << "', ignored." << endl;
+      continue;
+    }
+    config.extraMethods.push_back(make_pair((Config::SizeMethod)(sm-sizes), (Config::Method)(em-accepts)));
+  }
+}
+
 /* -------------------------------------------------------------------------- */
 void processArgs(int argc, char *argv[], Config & config)
 {
@@ -1393,9 +283,15 @@ void processArgs(int argc, char *argv[], Config & config)
   for (int i = 1; i < argc; i++)
   {
      string arg = argv[i];
+     if ((arg.find("-str") == 0) && (i<(argc-1))) config.streamSeconds = atoi(argv[++i]); else
      if ((arg.find("-sta") == 0) && (i<(argc-1))) config.user_starttime = argv[++i]; else
      if ((arg.find("-sto") == 0) && (i<(argc-1))) config.user_stoptime = argv[++i]; else
      if (arg.find("-fb") == 0) config.firstBin=atoi(argv[++i]); else
+     if (arg.find("-index") == 0) config.useIndex = true; else
+     if (arg.find("-cache") == 0) config.useCache = true; else
+     if (arg.find("-pr") == 0) config.profile = true; else
+     if ((arg.find("-p") == 0) && (i<(argc-1))) config.particleFile = argv[++i]; else
+     if ((arg.find("-m") == 0) && (i<(argc-1))) parseMethods(argv[++i], config); else
      if (arg.find("-n") == 0) config.shattercorrect=0; else
      if (arg.find("-a") == 0) config.eawmethod	= Config::ENTIRE_IN; else
      if (arg.find("-c") == 0) config.eawmethod	= Config::CENTER_IN; else
@@ -1403,9 +299,11 @@ void processArgs(int argc, char *argv[], Config & config)
      if (arg.find("-ead") == 0) config.smethod= Config::EQUIV_AREA_DIAM; else
      if (arg.find("-x") == 0) config.smethod	= Config::X; else
      if (arg.find("-y") == 0) config.smethod	= Config::Y; else
+     if (arg.find("-w") == 0) config.warmStart	= true; else
      if (arg.find("-v") == 0) config.verbose	= true; else
      if (arg.find("-d") == 0) config.debug	= true; else
      if (arg.find("-o") == 0) config.outputFile	=argv[++i]; else
+     if ((arg.find("-th") == 0) && (i<(argc-1))) config.nThreads = atoi(argv[++i]); else
      if (arg.find("-z") == 0) binoffset	= 1; else
      config.inputFile = arg;
   }
@@ -1442,10 +340,38 @@ int usage(const char* argv0)
   cerr << "         Apply equivalent area diamemter sizing" << endl;
   cerr << "   -noshattercorrect" << endl;
   cerr << "         Turn off shattering rejection and corrections" << endl;
+  cerr << "   -methods [list]" << endl;
+  cerr << "         Also bin with these sizing/acceptance methods in the same pass, each" << endl;
+  cerr << "         written with the method added to the variable suffix, e.g. A2DCA_LPO_XA." << endl;
+  cerr << "         Comma separated pairs of sizing c(ircle), x, y, e(ad) and acceptance" << endl;
+  cerr << "         a(ll-in), c(enter-in), r(econstruction), e.g. xa,ya,ec; or all." << endl;
+  cerr << "   -particles [filename]" << endl;
+  cerr << "         Also write every sized particle (sizes, areas, interarrival time," << endl;
+  cerr << "         reject flags) to this netCDF file." << endl;
+  cerr << "   -stream [seconds]" << endl;
+  cerr << "         Write output in blocks of this many seconds as they complete, instead" << endl;
+  cerr << "         of holding the whole time range in memory. e.g. 3600" << endl;
+  cerr << "   -warmstart" << endl;
+  cerr << "         Start each second's interarrival fit from the previous second's" << endl;
+  cerr << "         result. Faster, but may converge to a different solution." << endl;
+  cerr << "   -profile" << endl;
+  cerr << "         Time each processing stage (read, decode, rle, size, fillholes, fit, bin," << endl;
+  cerr << "         derived, write) and count records, particles, rejects by reason and" << endl;
+  cerr << "         fit iterations.  Printed at the end as 'profile probe=...' key=value lines." << endl;
+  cerr << "         Stage times are summed over threads; decode includes rle, size and fillholes." << endl;
   cerr << "   -fb #" << endl;
   cerr << "         Set first bin for accumulations and totals." << endl;
   cerr << "   -verbose" << endl;
   cerr << "         Send extra output to console" << endl;;
+  cerr << "   -index" << endl;
+  cerr << "         Use a record time index file (.2Didx) to go straight to -starttime." << endl;
+  cerr << "         The index is built on the first run if it does not exist." << endl;
+  cerr << "   -cache" << endl;
+  cerr << "         Keep the decoded particles in a cache file per probe (.2Dfeat), and reuse" << endl;
+  cerr << "         it on later runs of the same file and time range, skipping the decode." << endl;
+  cerr << "         For re-running with different sizing, rejection or binning options." << endl;
+  cerr << "   -threads #" << endl;
+  cerr << "         Number of threads used to decode records, default is one per core" << endl;
   cerr << "   -o file_name" << endl;
   cerr << "         Specify output file, instead of default output name" << endl;
   cerr << "   -z" << endl;
@@ -1493,14 +419,47 @@ int main(int argc, char *argv[])
      return 1;
   }
 
-  Read2dStartEndTime(config, input_file);
+  streamoff dataStart = input_file.tellg();
+  Read2dStartEndTime(config, input_file, probes);
 
   input_file.close();
 
+  /* The processing pass reads records straight out of the mapped file, and
+   * the probes are handed pointers into it rather than copies.
+   */
+  RecordFile records(config.inputFile);
+  if (!records.isOpen()) {
+    cerr << "Unable to map " << config.inputFile << endl;
+    return 1;
+  }
+
   NetCDF ncFile(config);
   ReadBlankOuts(config, probes);
 
-  // Process all probes found in the file
+  ParticleFile *particleFile = 0;
+  if (config.particleFile.length())
+  {
+    particleFile = new ParticleFile(config.particleFile, config);
+    if (!particleFile->isOpen())
+      return 1;
+  }
+
+  /* Each probe is processed on its own worker thread, and the netCDF output
+   * is done from a single writer thread; streamed blocks as they are queued,
+   * whole probes in probe order.  Debug output is per particle, keep that in
+   * order by processing everything right here.
+   */
+  bool threaded = !config.debug;
+
+  // Record decoding within each probe is spread over a shared thread pool.
+  if (config.nThreads == 0)
+    config.nThreads = thread::hardware_concurrency();
+  ThreadPool *pool = 0;
+  if (threaded && config.nThreads > 1)
+    pool = new ThreadPool(config.nThreads);
+
+  // Set up a processing context for each probe found in the file.
+  vector<ProbeProcessor *> processors;
   for (size_t i = 0; i < probes.size(); i++)
   {
     cout	<< "Processing: " << probes[i].serialNumber << probes[i].suffix << endl
@@ -1510,13 +469,168 @@ int main(int argc, char *argv[])
 		<< " armwidth : " << probes[i].armWidth << endl
 		<< " FirstBin : " << probes[i].firstBin << endl;
 
-    int errorcode = process2d(config, ncFile, probes[i]);
+    processors.push_back(new ProbeProcessor(config, ncFile, probes[i], pool, particleFile));
+  }
+
+  /* Probes with a particle cache from an earlier run of this file are
+   * accumulated from it now and need no records; the others build one.
+   * Debug output is printed while decoding, so no cache for that.
+   */
+  if (config.useCache && !config.debug)
+    for (size_t i = 0; i < processors.size(); i++)
+      processors[i]->UseCache(records);
+
+  auto writeProbe = [&](size_t i)
+  {
+    int errorcode = processors[i]->Write();
 
     if (!errorcode)
       cout << endl << "Successfully processed probe " << i << endl;
     else
       cout << endl << "Error on probe " << i << endl;
+
+    if (config.verbose)
+    {
+      const FitStats & fs = processors[i]->fitStats();
+      cout << "Interarrival fits: " << fs.fits << ", iterations: " << fs.iterations
+	<< " (mean " << (fs.fits ? (double)fs.iterations / fs.fits : 0.0)
+	<< ", max " << fs.maxIterations << "), warm starts: " << fs.warmStarts
+	<< ", unconverged: " << fs.unconverged << ", too few counts: " << fs.lowCounts << endl;
+    }
+
+    processors[i]->ReportProfile(cout);
+  };
+
+  thread writer;
+  if (threaded)
+  {
+    ncFile.EnableWriter();
+    for (size_t i = 0; i < processors.size(); i++)
+      processors[i]->Start();
+
+    writer = thread([&]()
+    {
+      for (size_t i = 0; i < processors.size(); i++)
+      {
+        while (!processors[i]->Finished())
+          ncFile.NextJob()();
+        processors[i]->Join();
+        writeProbe(i);
+      }
+    });
+  }
+
+  /* With a time index, start reading a few records of each probe ahead of
+   * the start time instead of at the top of the file, and stop once each
+   * probe has a record past the end time.  Each probe sees the records
+   * either side that it would reading the whole file, so the results are
+   * the same.  Build the index on this pass if there isn't one.
+   */
+  const size_t indexWarmup = 4;	// Records of each probe before the start time.
+  TimeIndex index(config.inputFile);
+  bool buildIndex = false;
+  streamoff startPos = dataStart, stopPos = -1;
+  if (config.useIndex)
+  {
+    if (index.Read())
+    {
+      time_t day0 = config.starttime - config.starttime % 86400;
+      int64_t stop;
+      int64_t pos = index.Range(config.starttime, config.stoptime, day0, indexWarmup,
+				records, probes, stop);
+      startPos = (pos < 0) ? dataStart : pos;
+      stopPos = (pos < 0) ? startPos : stop;	// No records of these probes.
+      cout << "Using time index " << index.fileName() << ", starting at record "
+		<< (startPos - dataStart) / (streamoff)sizeof(P2d_rec) << endl;
+    }
+    else
+      buildIndex = true;
   }
 
+  /* Single pass through the file, route each record to the probe it belongs
+   * to.  Reading stops once every probe has passed the end time.
+   */
+  records.Seek(startPos);
+
+  Profile *readProfile = config.profile ? new Profile : 0;
+  const P2d_rec *buffer;
+  bool endOfFile = false;
+  long recCount;
+  for (recCount = 0; ; ++recCount)
+  {
+    bool active = false;
+    for (size_t i = 0; i < processors.size(); i++)
+      if (!processors[i]->Done()) active = true;
+
+    if (!active && !buildIndex)
+      break;
+
+    size_t pos = records.tell();
+    if (stopPos >= 0 && (streamoff)pos >= stopPos)
+      break;
+
+    int64_t readStart = readProfile ? Profile::now() : 0;
+    if ((buffer = records.Next()) == 0)
+    {
+      endOfFile = true;
+      break;
+    }
+
+    if (buildIndex && isProbeRecord(*buffer, probes))
+      index.Add(*buffer, pos);
+
+    // The file is mapped, the first look at a record is what reads it in.
+    size_t p = 0;
+    while (p < processors.size() && !processors[p]->Matches(*buffer))
+      ++p;
+    if (readProfile)
+      readProfile->Add(Profile::READ, Profile::now() - readStart);
+
+    if (p < processors.size() && !processors[p]->Done())
+    {
+      if (threaded)
+        processors[p]->Push(buffer);
+      else
+        processors[p]->ProcessRecord(*buffer);
+    }
+
+    if (!config.verbose && (recCount % 100 == 0))
+      cout	<< ntohs(buffer->hour) << ':' << ntohs(buffer->minute)
+		<< ':' << ntohs(buffer->second) << "." << ntohs(buffer->msec)
+		<< " - " << recCount << " records    \r" << flush;
+  }
+
+  if (buildIndex && endOfFile)
+  {
+    cout << endl << "Writing time index file " << index.fileName() << endl;
+    if (index.Write())
+      cerr << "Unable to write " << index.fileName() << endl;
+  }
+
+  if (threaded)
+  {
+    for (size_t i = 0; i < processors.size(); i++)
+      processors[i]->EndOfData();
+
+    writer.join();
+  }
+  else
+  {
+    for (size_t i = 0; i < processors.size(); i++)
+    {
+      processors[i]->ComputeDerived();
+      writeProbe(i);
+    }
+  }
+
+  if (readProfile)
+    readProfile->Report(cout, "file", recCount, recCount * sizeof(P2d_rec));
+
+  for (size_t i = 0; i < processors.size(); i++)
+    delete processors[i];
+  delete readProfile;
+  delete pool;
+  delete particleFile;
+
   return 0;
 }
@@ -0,0 +1,82 @@
+#include "record.h"
+
+#include <cstring>
+#include <cstdio>
+#include <arpa/inet.h>
+
+const unsigned char syncString[8] = { 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa };
+
+
+/* -------------------------------------------------------------------- */
+long long CIPTimeWord_Microseconds(long long slice)
+{
+  long long output;
+
+  int hour = (slice >> 35) & 0x001F;
+  int minute = (slice >> 29) & 0x003F;
+  int second = (slice >> 23) & 0x003F;
+  int msec = (slice >> 13) & 0x03FF;
+  int usec = slice & 0x1FFF;
+  output = (hour * 3600 + minute * 60 + second);
+  output *= 1000000;
+  output += msec * 1000;
+  output += usec / 8;   // 8 MHz clock or 125nS
+
+//printf("%02d:%02d:%02d.%03d - (%lld)\n", hour, minute, second, msec, output);
+
+  return output;
+}
+
+struct tm getTime(const P2d_rec *rec)
+{
+  struct tm tm;
+
+  memset(&tm, 0, sizeof(struct tm));
+  tm.tm_mday = ntohs(rec->day);
+  tm.tm_mon = ntohs(rec->month) - 1;
+  tm.tm_year = ntohs(rec->year) - 1900;
+  tm.tm_hour = ntohs(rec->hour);
+  tm.tm_min = ntohs(rec->minute);
+  tm.tm_sec = ntohs(rec->second);
+
+  return tm;
+}
+
+time_t GetUserTime(const P2d_rec *rec, std::string user_time)
+{
+  struct tm ftm, utm;
+
+  ftm = getTime(rec);
+  utm = ftm;
+  if (user_time.length())
+  {
+    int h, m, s;
+    sscanf(user_time.c_str(), "%02d%02d%02d", &h, &m, &s);
+    utm.tm_hour = h;
+    utm.tm_min = m;
+    utm.tm_sec = s;
+  }
+
+  return mktime(&utm);
+}
+
+
+time_t TwoDtime(const P2d_rec *rec)
+{
+  struct tm tm = getTime(rec);
+  return mktime(&tm);
+}
+
+// ----------------A FEW BYTE SWAPPING ROUTINES----------------
+unsigned long long endianswap_ull(unsigned long long x)
+{
+   x = (x>>56) |
+        ((x<<40) & 0x00FF000000000000ULL) |
+        ((x<<24) & 0x0000FF0000000000ULL) |
+        ((x<<8)  & 0x000000FF00000000ULL) |
+        ((x>>8)  & 0x00000000FF000000ULL) |
+        ((x>>24) & 0x0000000000FF0000ULL) |
+        ((x>>40) & 0x000000000000FF00ULL) |
+        (x<<56);
+        return x;
+}
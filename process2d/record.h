@@ -0,0 +1,41 @@
+#ifndef _record_h_
+#define _record_h_
+
+#include <string>
+#include <ctime>
+#include <cstddef>
+
+extern const unsigned char syncString[8];
+
+// Standard RAF record format for 2D records.
+typedef struct type_buffer {
+    char probetype;
+    char probenumber;
+    short hour;
+    short minute;
+    short second;
+    short year;
+    short month;
+    short day;
+    short tas;                  // True airspeed.
+    unsigned short msec;        // millisecond of data timestamp.
+    short overload;
+    unsigned char image[4096];
+} P2d_rec;
+
+
+struct tm getTime(const P2d_rec *rec);
+
+/**
+ * Return the time of the record, with hour, minute and second replaced
+ * by user_time (hhmmss), if one was given.
+ */
+time_t GetUserTime(const P2d_rec *rec, std::string user_time);
+
+time_t TwoDtime(const P2d_rec *rec);
+
+long long CIPTimeWord_Microseconds(long long slice);
+
+unsigned long long endianswap_ull(unsigned long long x);
+
+#endif